@@ -9,12 +9,17 @@
 #ifndef YCSB_C_CLIENT_H_
 #define YCSB_C_CLIENT_H_
 
+#include <algorithm>
+#include <deque>
 #include <iostream>
 #include <string>
 #include <atomic>
+#include <mutex>
 
 #include "db.h"
+#include "db_wrapper.h"
 #include "core_workload.h"
+#include "utils/affinity.h"
 #include "utils/countdown_latch.h"
 #include "utils/rate_limit.h"
 #include "utils/timer.h"
@@ -22,28 +27,164 @@
 
 namespace ycsbc {
 
-inline int ClientThread(ycsbc::DB *db, ycsbc::CoreWorkload *wl, const int num_ops, bool is_loading,
+// Waits for the limiter before issuing the next operation. In open-loop mode the
+// intended start time is handed to the DB wrapper so latency includes queueing delay.
+inline void Throttle(utils::RateLimiter *rlim, int n = 1) {
+  if (rlim->open_loop()) {
+    DBWrapper::SetIntendedStartTime(rlim->Schedule(n));
+  } else {
+    rlim->Consume(n);
+  }
+}
+
+// The logical clients of one client thread. Every client has one operation
+// pending, drawn when the client became ready, that is when its previous
+// operation completed. Clients are served in the order they became ready
+// and each operation is timed from that moment, so its latency includes the
+// time it queued behind the clients ahead of it but not the operations of
+// clients that became ready after it. The reads of clients next to each other
+// in the queue go to the DB as one BatchRead, every member timed from when its
+// own client became ready; all other operations, inserts included, are issued
+// one at a time.
+class LogicalClientQueue {
+ public:
+  LogicalClientQueue(CoreWorkload *wl, int clients, bool is_loading)
+      : wl_(wl), clients_(clients), is_loading_(is_loading) {}
+
+  // Issues the operation of the client at the head of the queue, or the reads
+  // of the clients at the head, at most max_ops of them, and returns how many
+  // operations were issued. All clients become ready on the first call.
+  int Step(DB *db, utils::RateLimiter *rlim, int max_ops) {
+    if (queue_.empty()) {
+      const DBWrapper::Clock::time_point now = DBWrapper::Clock::now();
+      for (int i = 0; i < clients_; i++) {
+        queue_.push_back({NextOperation(), now});
+      }
+    }
+
+    // a batch reads one set of fields for all of its keys
+    size_t n = 1;
+    if (queue_.front().op == READ && wl_->read_all_fields()) {
+      while (n < queue_.size() && n < static_cast<size_t>(max_ops) && queue_[n].op == READ) {
+        n++;
+      }
+    }
+
+    // open-loop requests start when scheduled, whichever client takes them;
+    // otherwise at the later of the client becoming ready and the limiter
+    // letting the operations go
+    starts_.clear();
+    if (rlim && rlim->open_loop()) {
+      starts_.assign(n, rlim->Schedule(n));
+    } else {
+      const DBWrapper::Clock::time_point released = rlim ? rlim->Consume(n) : DBWrapper::Clock::time_point();
+      for (size_t i = 0; i < n; i++) {
+        starts_.push_back(std::max(queue_[i].ready, released));
+      }
+    }
+
+    if (n > 1) {
+      DBWrapper::ClearIntendedStartTime();
+      DBWrapper::SetMemberStartTimes(&starts_);
+      wl_->DoReadGroup(*db, n);
+      DBWrapper::SetMemberStartTimes(nullptr);
+    } else {
+      DBWrapper::SetIntendedStartTime(starts_[0]);
+      if (is_loading_) {
+        wl_->DoInsert(*db);
+      } else {
+        wl_->DoOperation(*db, queue_.front().op);
+      }
+    }
+
+    const DBWrapper::Clock::time_point done = DBWrapper::Clock::now();
+    for (size_t i = 0; i < n; i++) {
+      queue_.pop_front();
+      queue_.push_back({NextOperation(), done});
+    }
+    return n;
+  }
+
+ private:
+  struct Client {
+    Operation op;
+    DBWrapper::Clock::time_point ready;
+  };
+
+  Operation NextOperation() {
+    return is_loading_ ? INSERT : wl_->NextOperation();
+  }
+
+  CoreWorkload *wl_;
+  const int clients_;
+  const bool is_loading_;
+  std::deque<Client> queue_;
+  std::vector<DBWrapper::Clock::time_point> starts_;
+};
+
+// Hands the operations db measured but did not time yet to the measurements,
+// before the phase totals are taken.
+inline void FlushSamples(DB *db) {
+  if (DBWrapper *wrapper = dynamic_cast<DBWrapper *>(db)) {
+    wrapper->FlushSamples();
+  }
+}
+
+// Pins the calling client thread and sets its memory policy, before it
+// initializes its DB or allocates any of its buffers.
+inline void PlaceThread(const utils::ThreadPlacement &placement, int index) {
+  try {
+    placement.Apply(index);
+  } catch (const utils::Exception &e) {
+    std::cerr << "Caught exception: " << e.what() << std::endl;
+    exit(1);
+  }
+}
+
+inline int ClientThread(ycsbc::DB *db, ycsbc::CoreWorkload *wl, int thread_id, const int num_ops, bool is_loading,
                         bool init_db, bool cleanup_db, utils::CountDownLatch *latch, utils::RateLimiter *rlim) {
 
   try {
+    wl->InitThread(thread_id);
     if (init_db) {
       db->Init();
     }
 
+    const int clients = wl->clients_per_thread();
+    const int batch_size = wl->batch_size();
+    LogicalClientQueue logical_clients(wl, clients, is_loading);
     int ops = 0;
-    for (int i = 0; i < num_ops; ++i) {
+    for (int i = 0; i < num_ops; ) {
+      if (clients > 1) {
+        int n = logical_clients.Step(db, rlim, num_ops - i);
+        i += n;
+        ops += n;
+        continue;
+      }
+      int n = std::min(batch_size, num_ops - i);
       if (rlim) {
-        rlim->Consume(1);
+        Throttle(rlim, n);
       }
 
-      if (is_loading) {
-        wl->DoInsert(*db);
+      if (n > 1) {
+        if (is_loading) {
+          wl->DoInsertBatch(*db, n);
+        } else {
+          wl->DoTransactionBatch(*db, n);
+        }
       } else {
-        wl->DoTransaction(*db);
+        if (is_loading) {
+          wl->DoInsert(*db);
+        } else {
+          wl->DoTransaction(*db);
+        }
       }
-      ops++;
+      i += n;
+      ops += n;
     }
+    DBWrapper::ClearIntendedStartTime();
 
+    FlushSamples(db);
     if (cleanup_db) {
       db->Cleanup();
     }
@@ -56,44 +197,142 @@ inline int ClientThread(ycsbc::DB *db, ycsbc::CoreWorkload *wl, const int num_op
   }
 }
 
-inline int ClientThreadWithWarmup(ycsbc::DB *db, ycsbc::CoreWorkload *wl, const int num_ops, bool is_loading,
-                                  bool init_db, bool cleanup_db, utils::CountDownLatch *latch, 
-                                  utils::CountDownLatch *warmup_latch, std::atomic<bool> *measurement_started,
-                                  utils::Timer<double> *measurement_timer, const int warmup_ops, utils::RateLimiter *rlim) {
+inline int BulkLoadThread(ycsbc::DB *db, ycsbc::CoreWorkload *wl, int thread_id, uint64_t first_key_num,
+                          const int num_ops, bool init_db, bool cleanup_db, utils::CountDownLatch *latch) {
 
   try {
+    wl->InitThread(thread_id);
     if (init_db) {
       db->Init();
     }
 
+    int ops = wl->DoBulkLoad(*db, first_key_num, num_ops);
+
+    FlushSamples(db);
+    if (cleanup_db) {
+      db->Cleanup();
+    }
+
+    latch->CountDown();
+    return ops;
+  } catch (const utils::Exception &e) {
+    std::cerr << "Caught exception: " << e.what() << std::endl;
+    exit(1);
+  }
+}
+
+// Switches a phase from warmup to measurement, once and for all client
+// threads, by setting the flag the DB wrappers of the phase were created
+// with. With a warmup operation count, every thread reports the end of its
+// share through ThreadWarmedUp and the last one starts the measurement;
+// with a warmup time the main thread calls Start. No thread waits for
+// another either way.
+class MeasurementEpoch {
+ public:
+  MeasurementEpoch(std::atomic<bool> *measuring, int warming_threads)
+      : measuring_(measuring), warming_threads_(warming_threads), started_(false) {
+    measuring_->store(false, std::memory_order_relaxed);
+  }
+
+  bool measuring() const { return measuring_->load(std::memory_order_relaxed); }
+
+  void Start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!started_) {
+      timer_.Start();
+      started_ = true;
+      measuring_->store(true, std::memory_order_relaxed);
+    }
+  }
+
+  void ThreadWarmedUp() {
+    if (warming_threads_.fetch_sub(1) == 1) {
+      Start();
+    }
+  }
+
+  // false if the clients finished before the measurement started
+  bool started() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return started_;
+  }
+
+  // seconds since the measurement started, 0 if it never did
+  double Elapsed() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return started_ ? timer_.End() : 0;
+  }
+
+ private:
+  std::atomic<bool> *measuring_;
+  std::atomic<int> warming_threads_;
+  std::mutex mutex_;
+  bool started_;
+  utils::Timer<double> timer_;
+};
+
+inline int ClientThreadWithWarmup(ycsbc::DB *db, ycsbc::CoreWorkload *wl, int thread_id, const int num_ops,
+                                  bool is_loading, bool init_db, bool cleanup_db, utils::CountDownLatch *latch,
+                                  MeasurementEpoch *epoch, const int warmup_ops, utils::RateLimiter *rlim,
+                                  const std::atomic<bool> *stop) {
+
+  try {
+    wl->InitThread(thread_id);
+    if (init_db) {
+      db->Init();
+    }
+
+    const int clients = wl->clients_per_thread();
+    const int batch_size = wl->batch_size();
+    LogicalClientQueue logical_clients(wl, clients, is_loading);
     int ops = 0;
-    for (int i = 0; i < num_ops; ++i) {
-      if (rlim) {
-        rlim->Consume(1);
+    bool warmed_up = false;
+    // stop ends the phase early, at its time limit
+    for (int i = 0; i < num_ops && !stop->load(std::memory_order_relaxed); ) {
+      if (!warmed_up && i >= warmup_ops) {
+        warmed_up = true;
+        epoch->ThreadWarmedUp();
       }
 
-      // Check if we've completed warmup operations
-      if (i == warmup_ops) {
-        warmup_latch->CountDown();
-        warmup_latch->Await(); // Wait for all threads to complete warmup
-        
-        // Only one thread should start the measurement timer
-        bool expected = false;
-        if (measurement_started->compare_exchange_strong(expected, true)) {
-          measurement_timer->Start();
-        }
+      // operations stay warmup until every thread is done with its share;
+      // warmup operations are never batched, and the logical clients become
+      // ready once the measurement starts
+      bool in_warmup = !epoch->measuring();
+      if (!in_warmup && clients > 1) {
+        int n = logical_clients.Step(db, rlim, num_ops - i);
+        i += n;
+        ops += n;
+        continue;
+      }
+      int n = in_warmup ? 1 : std::min(batch_size, num_ops - i);
+      if (rlim) {
+        Throttle(rlim, n);
       }
 
-      if (is_loading) {
-        wl->DoInsert(*db);
+      if (n > 1) {
+        if (is_loading) {
+          wl->DoInsertBatch(*db, n);
+        } else {
+          wl->DoTransactionBatch(*db, n);
+        }
       } else {
-        // Check if we are in warmup period
-        bool in_warmup = (i < warmup_ops);
-        wl->DoTransaction(*db, in_warmup);
+        if (is_loading) {
+          wl->DoInsert(*db);
+        } else {
+          wl->DoTransaction(*db, in_warmup);
+        }
       }
-      ops++;
+      i += n;
+      ops += n;
+    }
+    // a thread stopped early still counts as warmed up, or the measurement
+    // would never start
+    if (!warmed_up) {
+      epoch->ThreadWarmedUp();
     }
+    DBWrapper::ClearIntendedStartTime();
 
+    FlushSamples(db);
     if (cleanup_db) {
       db->Cleanup();
     }
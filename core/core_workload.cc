@@ -11,11 +11,13 @@
 #include "zipfian_generator.h"
 #include "scrambled_zipfian_generator.h"
 #include "skewed_latest_generator.h"
+#include "hotspot_shift_generator.h"
 #include "const_generator.h"
 #include "core_workload.h"
 #include "random_byte_generator.h"
 #include "random_counter_generator.h"
 #include "random_acknowledged_counter_generator.h"
+#include "utils/random.h"
 #include "utils/utils.h"
 
 #include <algorithm>
@@ -32,12 +34,16 @@ const char *ycsbc::kOperationString[ycsbc::MAXOPTYPE] = {
   "SCAN",
   "READMODIFYWRITE",
   "DELETE",
+  "BATCHREAD",
+  "BATCHWRITE",
   "INSERT-FAILED",
   "READ-FAILED",
   "UPDATE-FAILED",
   "SCAN-FAILED",
   "READMODIFYWRITE-FAILED",
-  "DELETE-FAILED"
+  "DELETE-FAILED",
+  "BATCHREAD-FAILED",
+  "BATCHWRITE-FAILED"
 };
 
 const string CoreWorkload::TABLENAME_PROPERTY = "table";
@@ -105,18 +111,61 @@ const std::string CoreWorkload::ZIPFIAN_CONST_PROPERTY = "zipfian_const";
 const string CoreWorkload::HOT_DATA_RATIO_PROPERTY = "hot_data_ratio";
 const string CoreWorkload::HOT_DATA_RATIO_DEFAULT = "1.0";
 
+const string CoreWorkload::HOTSPOT_SHIFT_INTERVAL_PROPERTY = "hotspot.shift_interval";
+const string CoreWorkload::HOTSPOT_SHIFT_INTERVAL_DEFAULT = "0";
+
+const string CoreWorkload::HOTSPOT_SHIFT_MODE_PROPERTY = "hotspot.shift_mode";
+const string CoreWorkload::HOTSPOT_SHIFT_MODE_DEFAULT = "slide";
+
 const string CoreWorkload::WARMUP_RATIO_PROPERTY = "warmup_ratio";
 const string CoreWorkload::WARMUP_RATIO_DEFAULT = "0.0";
 
+const string CoreWorkload::BATCH_SIZE_PROPERTY = "batchsize";
+const string CoreWorkload::BATCH_SIZE_DEFAULT = "1";
+
+const string CoreWorkload::CLIENTS_PER_THREAD_PROPERTY = "clients.per_thread";
+const string CoreWorkload::CLIENTS_PER_THREAD_DEFAULT = "1";
+
+const string CoreWorkload::SEED_PROPERTY = "seed";
+const string CoreWorkload::SEED_DEFAULT = "";
+
 namespace ycsbc {
 
+namespace {
+  std::atomic<uint64_t> workload_id{0};
+
+  template <typename Value>
+  std::unique_ptr<ycsbc::Generator<Value>> CloneGenerator(const ycsbc::Generator<Value> *prototype,
+                                                           uint64_t seed) {
+    ycsbc::Generator<Value> *clone = prototype->Clone(seed);
+    if (clone == nullptr) {
+      throw ycsbc::utils::Exception("generator cannot be cloned per thread");
+    }
+    return std::unique_ptr<ycsbc::Generator<Value>>(clone);
+  }
+} // anonymous
+
+thread_local uint64_t CoreWorkload::cached_workload_id_ = 0;
+thread_local CoreWorkload::ThreadState *CoreWorkload::cached_thread_state_ = nullptr;
+
 void CoreWorkload::Init(const utils::Properties &p) {
+  id_ = workload_id.fetch_add(1) + 1;
+  std::string seed = p.GetProperty(SEED_PROPERTY, SEED_DEFAULT);
+  seed_ = seed.empty() ? utils::RandomSeed() : std::stoull(seed);
+  // shared sequences and the value pool draw from the first seeds, threads mix in their id
+  uint64_t seed_state = seed_;
+
   table_name_ = p.GetProperty(TABLENAME_PROPERTY,TABLENAME_DEFAULT);
 
   field_count_ = std::stoi(p.GetProperty(FIELD_COUNT_PROPERTY, FIELD_COUNT_DEFAULT));
   field_prefix_ = p.GetProperty(FIELD_NAME_PREFIX, FIELD_NAME_PREFIX_DEFAULT);
   field_len_generator_ = GetFieldLenGenerator(p);
 
+  field_names_.clear();
+  for (int i = 0; i < field_count_; ++i) {
+    field_names_.push_back(field_prefix_ + std::to_string(i));
+  }
+
   double read_proportion = std::stod(p.GetProperty(READ_PROPORTION_PROPERTY,
                                                    READ_PROPORTION_DEFAULT));
   double update_proportion = std::stod(p.GetProperty(UPDATE_PROPORTION_PROPERTY,
@@ -135,7 +184,9 @@ void CoreWorkload::Init(const utils::Properties &p) {
   int max_scan_len = std::stoi(p.GetProperty(MAX_SCAN_LENGTH_PROPERTY, MAX_SCAN_LENGTH_DEFAULT));
   std::string scan_len_dist = p.GetProperty(SCAN_LENGTH_DISTRIBUTION_PROPERTY,
                                             SCAN_LENGTH_DISTRIBUTION_DEFAULT);
+  int max_field_len = std::stoi(p.GetProperty(FIELD_LENGTH_PROPERTY, FIELD_LENGTH_DEFAULT));
   int insert_start = std::stoi(p.GetProperty(INSERT_START_PROPERTY, INSERT_START_DEFAULT));
+  insert_start_ = insert_start;
 
   zero_padding_ = std::stoi(p.GetProperty(ZERO_PADDING_PROPERTY, ZERO_PADDING_DEFAULT));
 
@@ -149,6 +200,20 @@ void CoreWorkload::Init(const utils::Properties &p) {
     throw utils::Exception("warmup_ratio must be between 0.0 and 1.0");
   }
 
+  batch_size_ = std::stoi(p.GetProperty(BATCH_SIZE_PROPERTY, BATCH_SIZE_DEFAULT));
+  if (batch_size_ < 1) {
+    throw utils::Exception("batchsize must be at least 1");
+  }
+
+  clients_per_thread_ = std::stoi(p.GetProperty(CLIENTS_PER_THREAD_PROPERTY,
+                                                CLIENTS_PER_THREAD_DEFAULT));
+  if (clients_per_thread_ < 1) {
+    throw utils::Exception("clients.per_thread must be at least 1");
+  }
+  if (clients_per_thread_ > 1 && batch_size_ > 1) {
+    throw utils::Exception("batchsize and clients.per_thread cannot be combined");
+  }
+
   read_all_fields_ = utils::StrToBool(p.GetProperty(READ_ALL_FIELDS_PROPERTY,
                                                     READ_ALL_FIELDS_DEFAULT));
   write_all_fields_ = utils::StrToBool(p.GetProperty(WRITE_ALL_FIELDS_PROPERTY,
@@ -185,17 +250,28 @@ void CoreWorkload::Init(const utils::Properties &p) {
     op_chooser_.AddValue(READMODIFYWRITE, readmodifywrite_proportion);
   }
 
-  // Initialize warmup operation chooser with only SCAN operations
+  // Warmup only reads: scans if the workload has any, point reads otherwise
   if (scan_proportion > 0) {
     warmup_op_chooser_.AddValue(SCAN, 1.0);
+  } else {
+    warmup_op_chooser_.AddValue(READ, 1.0);
   }
 
+  // values are copied out of one pool of random printable bytes at random
+  // offsets instead of drawing a random number per byte
+  utils::Xoshiro256 pool_rng(utils::SplitMix64(seed_state));
+  RandomByteGenerator byte_generator(pool_rng);
+  value_pool_.resize(kValuePoolSize + max_field_len);
+  std::generate(value_pool_.begin(), value_pool_.end(), [&]() { return byte_generator.Next(); });
+
   if (random_inserts_) {
-    insert_key_sequence_ = new RandomCounterGenerator(insert_start, record_count_);
+    insert_key_sequence_ = new RandomCounterGenerator(insert_start, record_count_,
+                                                      utils::SplitMix64(seed_state));
     
     int op_count = std::stoi(p.GetProperty(OPERATION_COUNT_PROPERTY));
     int max_new_keys = (int)(op_count * insert_proportion * 2);
-    transaction_insert_key_sequence_ = new RandomAcknowledgedCounterGenerator(record_count_, max_new_keys);
+    transaction_insert_key_sequence_ = new RandomAcknowledgedCounterGenerator(record_count_, max_new_keys,
+                                                                              utils::SplitMix64(seed_state));
   } else {
     insert_key_sequence_ = new CounterGenerator(insert_start);
     transaction_insert_key_sequence_ = new AcknowledgedCounterGenerator(record_count_);
@@ -253,6 +329,28 @@ void CoreWorkload::Init(const utils::Properties &p) {
     throw utils::Exception("Unknown request distribution: " + request_dist);
   }
 
+  const double shift_interval = std::stod(p.GetProperty(HOTSPOT_SHIFT_INTERVAL_PROPERTY,
+                                                       HOTSPOT_SHIFT_INTERVAL_DEFAULT));
+  if (shift_interval < 0) {
+    throw utils::Exception("hotspot.shift_interval must not be negative");
+  } else if (shift_interval > 0) {
+    if (request_dist == "latest") {
+      throw utils::Exception("hotspot shifting does not apply to the latest distribution");
+    }
+    const std::string shift_mode = p.GetProperty(HOTSPOT_SHIFT_MODE_PROPERTY, HOTSPOT_SHIFT_MODE_DEFAULT);
+    HotspotShiftGenerator::Mode mode;
+    if (shift_mode == "slide") {
+      mode = HotspotShiftGenerator::kSlide;
+    } else if (shift_mode == "jump") {
+      mode = HotspotShiftGenerator::kJump;
+    } else {
+      throw utils::Exception("Unknown hotspot shift mode: " + shift_mode);
+    }
+    uint64_t window = std::max<uint64_t>(1, record_count_ - hot_data_start);
+    hot_key_chooser_ = new HotspotShiftGenerator(hot_key_chooser_, record_count_, window,
+                                                 shift_interval, mode, seed_);
+  }
+
   field_chooser_ = new UniformGenerator(0, field_count_ - 1);
 
   if (scan_len_dist == "uniform") {
@@ -264,6 +362,37 @@ void CoreWorkload::Init(const utils::Properties &p) {
   }
 }
 
+CoreWorkload::ThreadState *CoreWorkload::NewThreadState(int thread_id) {
+  uint64_t seed = seed_ ^ utils::FNVHash64(thread_id);
+  std::unique_ptr<ThreadState> state(new ThreadState());
+  state->field_len_generator = CloneGenerator(field_len_generator_, utils::SplitMix64(seed));
+  state->op_chooser = CloneGenerator<Operation>(&op_chooser_, utils::SplitMix64(seed));
+  state->warmup_op_chooser = CloneGenerator<Operation>(&warmup_op_chooser_, utils::SplitMix64(seed));
+  state->key_chooser = CloneGenerator(key_chooser_, utils::SplitMix64(seed));
+  state->hot_key_chooser = CloneGenerator(hot_key_chooser_, utils::SplitMix64(seed));
+  state->field_chooser = CloneGenerator(field_chooser_, utils::SplitMix64(seed));
+  state->scan_len_chooser = CloneGenerator(scan_len_chooser_, utils::SplitMix64(seed));
+  state->value_rng.Seed(utils::SplitMix64(seed));
+
+  std::lock_guard<std::mutex> lock(thread_states_mutex_);
+  thread_states_.push_back(std::move(state));
+  return thread_states_.back().get();
+}
+
+void CoreWorkload::InitThread(int thread_id) {
+  cached_thread_state_ = NewThreadState(thread_id);
+  cached_workload_id_ = id_;
+}
+
+CoreWorkload::ThreadState &CoreWorkload::GetThreadState() {
+  // keyed by workload id rather than address, so a new workload never sees a stale state
+  if (cached_workload_id_ != id_) {
+    cached_thread_state_ = NewThreadState(next_thread_id_.fetch_add(1));
+    cached_workload_id_ = id_;
+  }
+  return *cached_thread_state_;
+}
+
 ycsbc::Generator<uint64_t> *CoreWorkload::GetFieldLenGenerator(
     const utils::Properties &p) {
   string field_len_dist = p.GetProperty(FIELD_LENGTH_DISTRIBUTION_PROPERTY,
@@ -281,41 +410,57 @@ ycsbc::Generator<uint64_t> *CoreWorkload::GetFieldLenGenerator(
 }
 
 std::string CoreWorkload::BuildKeyName(uint64_t key_num) {
+  std::string key;
+  BuildKeyName(key_num, key);
+  return key;
+}
+
+void CoreWorkload::BuildKeyName(uint64_t key_num, std::string &key) {
   if (!ordered_inserts_ && !random_inserts_) {
     key_num = utils::Hash(key_num);
   }
-  std::string prekey = "user";
-  std::string value = std::to_string(key_num);
-  int fill = std::max(0, zero_padding_ - static_cast<int>(value.size()));
-  return prekey.append(fill, '0').append(value);
+  // digits are formatted backwards into a buffer wide enough for any uint64_t
+  char digits[20];
+  char *end = digits + sizeof(digits);
+  char *p = end;
+  do {
+    *--p = static_cast<char>('0' + key_num % 10);
+    key_num /= 10;
+  } while (key_num != 0);
+  int len = static_cast<int>(end - p);
+  int fill = std::max(0, zero_padding_ - len);
+  key.assign("user", 4);
+  key.append(fill, '0').append(p, len);
+}
+
+void CoreWorkload::FillValue(std::string &value, uint64_t len, ThreadState &state) {
+  value.assign(value_pool_.data() + state.value_rng.Uniform(kValuePoolSize), len);
 }
 
 void CoreWorkload::BuildValues(std::vector<ycsbc::DB::Field> &values) {
+  // fields are overwritten in place, so a reused vector keeps its buffers
+  ThreadState &state = GetThreadState();
+  Generator<uint64_t> *field_len_generator = state.field_len_generator.get();
+  values.resize(field_count_);
   for (int i = 0; i < field_count_; ++i) {
-    values.push_back(DB::Field());
-    ycsbc::DB::Field &field = values.back();
-    field.name.append(field_prefix_).append(std::to_string(i));
-    uint64_t len = field_len_generator_->Next();
-    field.value.reserve(len);
-    RandomByteGenerator byte_generator;
-    std::generate_n(std::back_inserter(field.value), len, [&]() { return byte_generator.Next(); } );
+    ycsbc::DB::Field &field = values[i];
+    field.name = field_names_[i];
+    FillValue(field.value, field_len_generator->Next(), state);
   }
 }
 
 void CoreWorkload::BuildSingleValue(std::vector<ycsbc::DB::Field> &values) {
-  values.push_back(DB::Field());
-  ycsbc::DB::Field &field = values.back();
-  field.name.append(NextFieldName());
-  uint64_t len = field_len_generator_->Next();
-  field.value.reserve(len);
-  RandomByteGenerator byte_generator;
-  std::generate_n(std::back_inserter(field.value), len, [&]() { return byte_generator.Next(); } );
+  ThreadState &state = GetThreadState();
+  values.resize(1);
+  ycsbc::DB::Field &field = values[0];
+  field.name = NextFieldName();
+  FillValue(field.value, state.field_len_generator->Next(), state);
 }
 
 uint64_t CoreWorkload::NextTransactionKeyNum() {
   uint64_t key_num;
   do {
-    key_num = key_chooser_->Next();
+    key_num = GetThreadState().key_chooser->Next();
   } while (key_num > transaction_insert_key_sequence_->Last());
   return key_num;
 }
@@ -323,25 +468,165 @@ uint64_t CoreWorkload::NextTransactionKeyNum() {
 uint64_t CoreWorkload::NextTransactionKeyNumHot() {
   uint64_t key_num;
   do {
-    key_num = hot_key_chooser_->Next();
+    key_num = GetThreadState().hot_key_chooser->Next();
   } while (key_num > transaction_insert_key_sequence_->Last());
   return key_num;
 }
 
-std::string CoreWorkload::NextFieldName() {
-  return std::string(field_prefix_).append(std::to_string(field_chooser_->Next()));
+const std::string &CoreWorkload::NextFieldName() {
+  return field_names_[GetThreadState().field_chooser->Next()];
+}
+
+const std::vector<std::string> *CoreWorkload::NextReadFields(ThreadState &state) {
+  if (read_all_fields()) {
+    return NULL;
+  }
+  state.fields.resize(1);
+  state.fields[0] = NextFieldName();
+  return &state.fields;
 }
 
 bool CoreWorkload::DoInsert(DB &db) {
-  const std::string key = BuildKeyName(insert_key_sequence_->Next());
-  std::vector<DB::Field> fields;
-  BuildValues(fields);
-  return db.Insert(table_name_, key, fields) == DB::kOK;
+  ThreadState &state = GetThreadState();
+  BuildKeyName(insert_key_sequence_->Next(), state.key);
+  BuildValues(state.values);
+  return db.Insert(table_name_, state.key, state.values) == DB::kOK;
+}
+
+bool CoreWorkload::DoInsertBatch(DB &db, int n) {
+  std::vector<std::string> keys;
+  std::vector<std::vector<DB::Field>> values(n);
+  keys.reserve(n);
+  for (int i = 0; i < n; i++) {
+    keys.push_back(BuildKeyName(insert_key_sequence_->Next()));
+    BuildValues(values[i]);
+  }
+  return db.BatchWrite(table_name_, keys, values) == DB::kOK;
+}
+
+int CoreWorkload::DoBulkLoad(DB &db, uint64_t first_key_num, int count) {
+  // Keys are built exactly as DoInsert would build them, then sorted so the
+  // binding can write them straight into its on-disk format.
+  std::vector<std::string> keys;
+  keys.reserve(count);
+  for (int i = 0; i < count; i++) {
+    keys.push_back(BuildKeyName(first_key_num + i));
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  DB::Status s = db.BeginBulkLoad(table_name_);
+  if (s == DB::kNotImplemented) {
+    throw utils::Exception("bulk load is not supported by this db");
+  } else if (s != DB::kOK) {
+    throw utils::Exception("bulk load failed to start");
+  }
+  int loaded = 0;
+  std::vector<DB::Field> values;
+  for (const std::string &key : keys) {
+    values.clear();
+    BuildValues(values);
+    if (db.BulkLoadPut(table_name_, key, values) == DB::kOK) {
+      loaded++;
+    }
+  }
+  if (db.FinishBulkLoad(table_name_) != DB::kOK) {
+    throw utils::Exception("bulk load failed to finish");
+  }
+  return loaded;
+}
+
+bool CoreWorkload::DoTransactionBatch(DB &db, int n) {
+  // Reads and inserts are grouped into one batch call each; the remaining
+  // operations are not full-record writes and run one by one.
+  std::vector<std::string> read_keys;
+  std::vector<std::string> insert_keys;
+  std::vector<std::vector<DB::Field>> insert_values;
+  std::vector<uint64_t> insert_key_nums;
+  bool ok = true;
+  for (int i = 0; i < n; i++) {
+    switch (GetThreadState().op_chooser->Next()) {
+      case READ:
+        read_keys.push_back(BuildKeyName(NextTransactionKeyNumHot()));
+        break;
+      case UPDATE:
+        ok = (TransactionUpdate(db) == DB::kOK) && ok;
+        break;
+      case INSERT: {
+        uint64_t key_num = transaction_insert_key_sequence_->Next();
+        insert_key_nums.push_back(key_num);
+        insert_keys.push_back(BuildKeyName(key_num));
+        insert_values.emplace_back();
+        BuildValues(insert_values.back());
+        break;
+      }
+      case SCAN:
+        ok = (TransactionScan(db) == DB::kOK) && ok;
+        break;
+      case READMODIFYWRITE:
+        ok = (TransactionReadModifyWrite(db) == DB::kOK) && ok;
+        break;
+      default:
+        throw utils::Exception("Operation request is not recognized!");
+    }
+  }
+
+  if (!read_keys.empty()) {
+    ok = BatchReadKeys(db, read_keys) && ok;
+  }
+  if (!insert_keys.empty()) {
+    ok = (db.BatchWrite(table_name_, insert_keys, insert_values) == DB::kOK) && ok;
+    for (uint64_t key_num : insert_key_nums) {
+      AcknowledgeInsert(key_num);
+    }
+  }
+  return ok;
+}
+
+bool CoreWorkload::BatchReadKeys(DB &db, const std::vector<std::string> &keys) {
+  std::vector<std::vector<DB::Field>> results;
+  std::vector<DB::Status> statuses;
+  if (read_all_fields()) {
+    return db.BatchRead(table_name_, keys, NULL, results, statuses) == DB::kOK;
+  }
+  // every read draws its own field; a BatchRead fetches one set of fields,
+  // so the keys go out in one batch per field drawn
+  ThreadState &state = GetThreadState();
+  std::vector<std::vector<std::string>> keys_by_field(field_count_);
+  for (const std::string &key : keys) {
+    keys_by_field[state.field_chooser->Next()].push_back(key);
+  }
+  bool ok = true;
+  std::vector<std::string> fields(1);
+  for (int i = 0; i < field_count_; i++) {
+    if (!keys_by_field[i].empty()) {
+      fields[0] = field_names_[i];
+      ok = (db.BatchRead(table_name_, keys_by_field[i], &fields, results, statuses) == DB::kOK) && ok;
+    }
+  }
+  return ok;
+}
+
+Operation CoreWorkload::NextOperation() {
+  return GetThreadState().op_chooser->Next();
+}
+
+bool CoreWorkload::DoReadGroup(DB &db, int n) {
+  std::vector<std::string> keys;
+  keys.reserve(n);
+  for (int i = 0; i < n; i++) {
+    keys.push_back(BuildKeyName(NextTransactionKeyNumHot()));
+  }
+  return BatchReadKeys(db, keys);
 }
 
 bool CoreWorkload::DoTransaction(DB &db) {
+  return DoOperation(db, NextOperation());
+}
+
+bool CoreWorkload::DoOperation(DB &db, Operation op) {
   DB::Status status;
-  switch (op_chooser_.Next()) {
+  switch (op) {
     case READ:
       status = TransactionRead(db);
       break;
@@ -367,7 +652,7 @@ bool CoreWorkload::DoTransaction(DB &db, bool is_warmup) {
   DB::Status status;
   if (is_warmup) {
     // During warmup, only perform READ and SCAN operations
-    switch (warmup_op_chooser_.Next()) {
+    switch (GetThreadState().warmup_op_chooser->Next()) {
       case READ:
         status = TransactionRead(db);
         break;
@@ -380,7 +665,7 @@ bool CoreWorkload::DoTransaction(DB &db, bool is_warmup) {
     }
   } else {
     // Normal operation mode
-    switch (op_chooser_.Next()) {
+    switch (GetThreadState().op_chooser->Next()) {
       case READ:
         status = TransactionRead(db);
         break;
@@ -404,83 +689,79 @@ bool CoreWorkload::DoTransaction(DB &db, bool is_warmup) {
 }
 
 DB::Status CoreWorkload::TransactionRead(DB &db) {
+  ThreadState &state = GetThreadState();
   // uint64_t key_num = NextTransactionKeyNum();
   uint64_t key_num = NextTransactionKeyNumHot();
-  const std::string key = BuildKeyName(key_num);
-  std::vector<DB::Field> result;
-  if (!read_all_fields()) {
-    std::vector<std::string> fields;
-    fields.push_back(NextFieldName());
-    return db.Read(table_name_, key, &fields, result);
-  } else {
-    return db.Read(table_name_, key, NULL, result);
-  }
+  BuildKeyName(key_num, state.key);
+  // the values are not inspected, so borrowed views are enough
+  return db.ReadView(table_name_, state.key, NextReadFields(state), state.view_result);
 }
 
 DB::Status CoreWorkload::TransactionReadModifyWrite(DB &db) {
+  ThreadState &state = GetThreadState();
   uint64_t key_num = NextTransactionKeyNum();
-  const std::string key = BuildKeyName(key_num);
-  std::vector<DB::Field> result;
+  BuildKeyName(key_num, state.key);
+  state.result.clear();
+  db.Read(table_name_, state.key, NextReadFields(state), state.result);
 
-  if (!read_all_fields()) {
-    std::vector<std::string> fields;
-    fields.push_back(NextFieldName());
-    db.Read(table_name_, key, &fields, result);
-  } else {
-    db.Read(table_name_, key, NULL, result);
-  }
-
-  std::vector<DB::Field> values;
   if (write_all_fields()) {
-    BuildValues(values);
+    BuildValues(state.values);
+    return db.Update(table_name_, state.key, state.values);
   } else {
-    BuildSingleValue(values);
+    BuildSingleValue(state.single_value);
+    return db.Update(table_name_, state.key, state.single_value);
   }
-  return db.Update(table_name_, key, values);
 }
 
 DB::Status CoreWorkload::TransactionScan(DB &db) {
+  ThreadState &state = GetThreadState();
   // uint64_t key_num = NextTransactionKeyNum();
   uint64_t key_num = NextTransactionKeyNumHot();
-  const std::string key = BuildKeyName(key_num);
-  int len = scan_len_chooser_->Next();
-  std::vector<std::vector<DB::Field>> result;
-  if (!read_all_fields()) {
-    std::vector<std::string> fields;
-    fields.push_back(NextFieldName());
-    return db.Scan(table_name_, key, len, &fields, result);
-  } else {
-    return db.Scan(table_name_, key, len, NULL, result);
-  }
+  BuildKeyName(key_num, state.key);
+  int len = state.scan_len_chooser->Next();
+  // rows are only counted, so the scan cost is the engine's iteration cost
+  return db.ScanVisit(table_name_, state.key, len, NextReadFields(state),
+                      [](const std::vector<DB::FieldView> &) { return true; });
 }
 
 DB::Status CoreWorkload::TransactionUpdate(DB &db) {
+  ThreadState &state = GetThreadState();
   uint64_t key_num = NextTransactionKeyNum();
-  const std::string key = BuildKeyName(key_num);
-  std::vector<DB::Field> values;
+  BuildKeyName(key_num, state.key);
   if (write_all_fields()) {
-    BuildValues(values);
+    BuildValues(state.values);
+    return db.Update(table_name_, state.key, state.values);
   } else {
-    BuildSingleValue(values);
+    BuildSingleValue(state.single_value);
+    return db.Update(table_name_, state.key, state.single_value);
   }
-  return db.Update(table_name_, key, values);
 }
 
 DB::Status CoreWorkload::TransactionInsert(DB &db) {
+  ThreadState &state = GetThreadState();
   uint64_t key_num = transaction_insert_key_sequence_->Next();
-  const std::string key = BuildKeyName(key_num);
-  std::vector<DB::Field> values;
-  BuildValues(values);
-  DB::Status s = db.Insert(table_name_, key, values);
-  
+  BuildKeyName(key_num, state.key);
+  BuildValues(state.values);
+  DB::Status s = db.Insert(table_name_, state.key, state.values);
+  AcknowledgeInsert(key_num);
+  return s;
+}
+
+uint64_t CoreWorkload::record_count() const {
+  if (random_inserts_) {
+    return record_count_;
+  }
+  // every key below the acknowledged limit has been inserted
+  return static_cast<AcknowledgedCounterGenerator*>(transaction_insert_key_sequence_)->Last() + 1;
+}
+
+void CoreWorkload::AcknowledgeInsert(uint64_t key_num) {
   // Only call Acknowledge if it's an AcknowledgedCounterGenerator
   if (!random_inserts_) {
     static_cast<AcknowledgedCounterGenerator*>(transaction_insert_key_sequence_)->Acknowledge(key_num);
   } else {
     static_cast<RandomAcknowledgedCounterGenerator*>(transaction_insert_key_sequence_)->Acknowledge(key_num);
   }
-  
-  return s;
 }
 
 } // ycsbc
@@ -10,6 +10,9 @@
 #ifndef YCSB_C_CORE_WORKLOAD_H_
 #define YCSB_C_CORE_WORKLOAD_H_
 
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
 #include "db.h"
@@ -20,6 +23,7 @@
 #include "random_counter_generator.h"
 #include "random_acknowledged_counter_generator.h"
 #include "utils/properties.h"
+#include "utils/random.h"
 #include "utils/utils.h"
 
 namespace ycsbc {
@@ -31,17 +35,27 @@ enum Operation {
   SCAN,
   READMODIFYWRITE,
   DELETE,
+  BATCHREAD,
+  BATCHWRITE,
   INSERT_FAILED,
   READ_FAILED,
   UPDATE_FAILED,
   SCAN_FAILED,
   READMODIFYWRITE_FAILED,
   DELETE_FAILED,
+  BATCHREAD_FAILED,
+  BATCHWRITE_FAILED,
   MAXOPTYPE
 };
 
 extern const char *kOperationString[MAXOPTYPE];
 
+// Batch latencies are reported alongside the per-op latencies of their
+// members, so they must not be counted again in operation totals.
+inline bool IsBatchOperation(Operation op) {
+  return op == BATCHREAD || op == BATCHWRITE || op == BATCHREAD_FAILED || op == BATCHWRITE_FAILED;
+}
+
 class CoreWorkload {
  public:
   ///
@@ -177,32 +191,106 @@ class CoreWorkload {
   static const std::string HOT_DATA_RATIO_PROPERTY;
   static const std::string HOT_DATA_RATIO_DEFAULT;
 
+  ///
+  /// Seconds per shift of the hot set of read/scan operations. 0 keeps the
+  /// hot set in place for the whole run.
+  ///
+  static const std::string HOTSPOT_SHIFT_INTERVAL_PROPERTY;
+  static const std::string HOTSPOT_SHIFT_INTERVAL_DEFAULT;
+
+  ///
+  /// How the hot set shifts. Options are "slide" (moves on by its own size
+  /// every interval, gradually) and "jump" (moves to a random position
+  /// once per interval).
+  ///
+  static const std::string HOTSPOT_SHIFT_MODE_PROPERTY;
+  static const std::string HOTSPOT_SHIFT_MODE_DEFAULT;
+
   ///
   /// Warmup ratio for warmup operations (0.0-1.0).
-  /// The first warmup_ratio * operation_count operations are considered warmup.
+  /// Every thread issues its share of warmup_ratio * operation_count operations
+  /// as warmup (reads or scans only, not measured); measurement starts once
+  /// all threads are through their share, without any thread waiting.
   ///
   static const std::string WARMUP_RATIO_PROPERTY;
   static const std::string WARMUP_RATIO_DEFAULT;
 
+  ///
+  /// The name of the property for the number of operations grouped into
+  /// one BatchRead/BatchWrite call. 1 disables batching. Without
+  /// readallfields every read draws its own field, and the reads of a batch
+  /// go out in one BatchRead per field drawn.
+  ///
+  static const std::string BATCH_SIZE_PROPERTY;
+  static const std::string BATCH_SIZE_DEFAULT;
+
+  ///
+  /// The name of the property for the number of logical clients multiplexed
+  /// on each client thread. Every logical client has one request pending,
+  /// timed from when the client became ready, so its latency includes the
+  /// time it queues behind the other clients of the thread. The reads of
+  /// clients queued next to each other are issued as one BatchRead, the other
+  /// operations one at a time.
+  ///
+  static const std::string CLIENTS_PER_THREAD_PROPERTY;
+  static const std::string CLIENTS_PER_THREAD_DEFAULT;
+
+  ///
+  /// The name of the property for the seed all random streams are derived
+  /// from. Empty picks a random seed, so runs are not repeatable.
+  ///
+  static const std::string SEED_PROPERTY;
+  static const std::string SEED_DEFAULT;
+
   ///
   /// Initialize the scenario.
   /// Called once, in the main client thread, before any operations are started.
   ///
   virtual void Init(const utils::Properties &p);
 
+  ///
+  /// Gives the calling thread its own copies of the random generators, seeded
+  /// from thread_id so each client thread draws a distinct, repeatable stream.
+  /// Threads that skip this get a state on first use.
+  ///
+  void InitThread(int thread_id);
+
   virtual bool DoInsert(DB &db);
   virtual bool DoTransaction(DB &db);
   virtual bool DoTransaction(DB &db, bool is_warmup);
+  virtual bool DoInsertBatch(DB &db, int n);
+  virtual bool DoTransactionBatch(DB &db, int n);
+
+  ///
+  /// The operations of a logical client are drawn when the client becomes
+  /// ready and issued later: on their own with DoOperation, or reads of
+  /// several clients together with DoReadGroup.
+  ///
+  Operation NextOperation();
+  virtual bool DoOperation(DB &db, Operation op);
+  virtual bool DoReadGroup(DB &db, int n);
+  virtual int DoBulkLoad(DB &db, uint64_t first_key_num, int count);
 
   bool read_all_fields() const { return read_all_fields_; }
   bool write_all_fields() const { return write_all_fields_; }
   double warmup_ratio() const { return warmup_ratio_; }
+  int batch_size() const { return batch_size_; }
+  int clients_per_thread() const { return clients_per_thread_; }
+  uint64_t insert_start() const { return insert_start_; }
+
+  ///
+  /// Number of records after the operations so far: recordcount plus the
+  /// keys inserted by transactions. Random inserts scatter their keys over a
+  /// sparse range beyond recordcount and are not counted.
+  ///
+  uint64_t record_count() const;
 
   CoreWorkload() :
       field_count_(0), read_all_fields_(false), write_all_fields_(false),
       field_len_generator_(nullptr), key_chooser_(nullptr), hot_key_chooser_(nullptr), field_chooser_(nullptr),
       scan_len_chooser_(nullptr), insert_key_sequence_(nullptr),
-      transaction_insert_key_sequence_(nullptr), ordered_inserts_(true), random_inserts_(false), record_count_(0), hot_data_ratio_(1.0), warmup_ratio_(0.0) {
+      transaction_insert_key_sequence_(nullptr), ordered_inserts_(true), random_inserts_(false), record_count_(0), insert_start_(0), hot_data_ratio_(1.0), warmup_ratio_(0.0),
+      batch_size_(1), clients_per_thread_(1), id_(0), seed_(0), next_thread_id_(kLazyThreadIdBase) {
   }
 
   virtual ~CoreWorkload() {
@@ -216,24 +304,60 @@ class CoreWorkload {
   }
 
  protected:
+  // Per-thread clones of the generators above, which only serve as prototypes
+  // once Init() is done. Shared sequences (insert keys) are not cloned.
+  struct ThreadState {
+    std::unique_ptr<Generator<uint64_t>> field_len_generator;
+    std::unique_ptr<Generator<Operation>> op_chooser;
+    std::unique_ptr<Generator<Operation>> warmup_op_chooser;
+    std::unique_ptr<Generator<uint64_t>> key_chooser;
+    std::unique_ptr<Generator<uint64_t>> hot_key_chooser;
+    std::unique_ptr<Generator<uint64_t>> field_chooser;
+    std::unique_ptr<Generator<uint64_t>> scan_len_chooser;
+    utils::Xoshiro256 value_rng;
+
+    // buffers reused across operations so the hot path does not allocate
+    std::string key;
+    std::vector<DB::Field> values;
+    std::vector<DB::Field> single_value;
+    std::vector<std::string> fields;
+    std::vector<DB::Field> result;
+    std::vector<DB::FieldView> view_result;
+  };
+  // thread ids handed out to threads that did not call InitThread
+  static const int kLazyThreadIdBase = 1 << 16;
+  // number of distinct value start offsets in value_pool_
+  static const size_t kValuePoolSize = 1 << 20;
+
+  ThreadState *NewThreadState(int thread_id);
+  ThreadState &GetThreadState();
+
   static Generator<uint64_t> *GetFieldLenGenerator(const utils::Properties &p);
   std::string BuildKeyName(uint64_t key_num);
+  void BuildKeyName(uint64_t key_num, std::string &key);
+  void FillValue(std::string &value, uint64_t len, ThreadState &state);
   void BuildValues(std::vector<DB::Field> &values);
   void BuildSingleValue(std::vector<DB::Field> &update);
 
   uint64_t NextTransactionKeyNum();
   uint64_t NextTransactionKeyNumHot();
-  std::string NextFieldName();
+  const std::string &NextFieldName();
+  // nullptr when all fields are read, otherwise one random field in state.fields
+  const std::vector<std::string> *NextReadFields(ThreadState &state);
 
   DB::Status TransactionRead(DB &db);
   DB::Status TransactionReadModifyWrite(DB &db);
   DB::Status TransactionScan(DB &db);
   DB::Status TransactionUpdate(DB &db);
   DB::Status TransactionInsert(DB &db);
+  void AcknowledgeInsert(uint64_t key_num);
+  bool BatchReadKeys(DB &db, const std::vector<std::string> &keys);
 
   std::string table_name_;
   int field_count_;
   std::string field_prefix_;
+  std::vector<std::string> field_names_;
+  std::string value_pool_;
   bool read_all_fields_;
   bool write_all_fields_;
   Generator<uint64_t> *field_len_generator_;
@@ -248,10 +372,21 @@ class CoreWorkload {
   bool ordered_inserts_;
   bool random_inserts_;
   size_t record_count_;
+  uint64_t insert_start_;
   int zero_padding_;
   double hot_data_ratio_;
   double warmup_ratio_;
+  int batch_size_;
+  int clients_per_thread_;
   bool enable_lorc_logger_;
+
+  uint64_t id_;
+  uint64_t seed_;
+  std::atomic<int> next_thread_id_;
+  std::mutex thread_states_mutex_;
+  std::vector<std::unique_ptr<ThreadState>> thread_states_;
+  static thread_local uint64_t cached_workload_id_;
+  static thread_local ThreadState *cached_thread_state_;
 };
 
 } // ycsbc
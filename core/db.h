@@ -11,11 +11,55 @@
 
 #include "utils/properties.h"
 
+#include <cstdint>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <functional>
+#include <utility>
 
 namespace ycsbc {
 
+///
+/// Engine internals of a single operation, for bindings that can break their
+/// operations down (see DB::ReadCounters). SST_OP is 1 if the operation
+/// touched an SST block, cached or not, and 0 if the memtables (or a cache
+/// above the block cache) answered it.
+///
+enum EngineCounter {
+  BLOCK_CACHE_HIT = 0,
+  BLOCK_READ,
+  BLOCK_READ_BYTES,
+  BYTES_READ,
+  MEMTABLE_GET,
+  SST_OP,
+  SEEK,
+  NEXT,
+  KEY_SKIPPED,
+  MAXCOUNTER
+};
+
+inline const char *const kEngineCounterString[MAXCOUNTER] = {
+  "block_cache_hit",
+  "block_read",
+  "block_read_bytes",
+  "bytes_read",
+  "memtable_get",
+  "sst_op",
+  "seek",
+  "next",
+  "key_skipped"
+};
+
+struct EngineCounters {
+  uint64_t value[MAXCOUNTER];
+};
+
+///
+/// Engine-wide statistics sampled during a run, as name/value pairs.
+///
+using EngineStats = std::vector<std::pair<std::string, uint64_t>>;
+
 ///
 /// Database interface layer.
 /// per-thread DB instance.
@@ -26,6 +70,15 @@ class DB {
     std::string name;
     std::string value;
   };
+  struct FieldView {
+    std::string_view name;
+    std::string_view value;
+  };
+  ///
+  /// Receives the rows of ScanVisit one at a time in key order. The views are
+  /// only valid for the duration of the call. Returns false to end the scan.
+  ///
+  using ScanVisitor = std::function<bool(const std::vector<FieldView> &row)>;
   enum Status {
     kOK = 0,
     kError,
@@ -54,6 +107,29 @@ class DB {
                    const std::vector<std::string> *fields,
                    std::vector<Field> &result) = 0;
   ///
+  /// Reads a record like Read, but returns views into memory owned by the
+  /// binding (pinned blocks, mapped pages, cursor buffers) instead of copies.
+  /// The views stay valid until the next call on this DB instance.
+  /// The default implementation copies through Read.
+  ///
+  /// @param table The name of the table.
+  /// @param key The key of the record to read.
+  /// @param fields The list of fields to read, or NULL for all of them.
+  /// @param result Cleared, then filled with field/value views for the result.
+  /// @return Zero on success, or a non-zero error code on error/record-miss.
+  ///
+  virtual Status ReadView(const std::string &table, const std::string &key,
+                          const std::vector<std::string> *fields,
+                          std::vector<FieldView> &result) {
+    view_storage_.clear();
+    result.clear();
+    Status s = Read(table, key, fields, view_storage_);
+    for (const Field &field : view_storage_) {
+      result.push_back({field.name, field.value});
+    }
+    return s;
+  }
+  ///
   /// Performs a range scan for a set of records in the database.
   /// Field/value pairs from the result are stored in a vector.
   ///
@@ -69,6 +145,35 @@ class DB {
                    int record_count, const std::vector<std::string> *fields,
                    std::vector<std::vector<Field>> &result) = 0;
   ///
+  /// Performs a range scan like Scan, but streams each record to a visitor
+  /// instead of materializing the result, so bindings can hand out views
+  /// straight from their iterators. The default implementation goes
+  /// through Scan.
+  ///
+  /// @param table The name of the table.
+  /// @param key The key of the first record to read.
+  /// @param record_count The maximum number of records to visit.
+  /// @param fields The list of fields to read, or NULL for all of them.
+  /// @param visitor Called once per record; returning false stops the scan.
+  /// @return Zero on success, or a non-zero error code on error.
+  ///
+  virtual Status ScanVisit(const std::string &table, const std::string &key,
+                           int record_count, const std::vector<std::string> *fields,
+                           const ScanVisitor &visitor) {
+    scan_storage_.clear();
+    Status s = Scan(table, key, record_count, fields, scan_storage_);
+    for (const std::vector<Field> &values : scan_storage_) {
+      scan_row_.clear();
+      for (const Field &field : values) {
+        scan_row_.push_back({field.name, field.value});
+      }
+      if (!visitor(scan_row_)) {
+        break;
+      }
+    }
+    return s;
+  }
+  ///
   /// Updates a record in the database.
   /// Field/value pairs in the specified vector are written to the record,
   /// overwriting any existing values with the same field names.
@@ -99,6 +204,110 @@ class DB {
   /// @return Zero on success, a non-zero error code on error.
   ///
   virtual Status Delete(const std::string &table, const std::string &key) = 0;
+  ///
+  /// Reads a batch of records from the database.
+  /// The default implementation issues one Read per key; bindings override
+  /// this to use a native multi-key lookup.
+  ///
+  /// @param table The name of the table.
+  /// @param keys The keys of the records to read.
+  /// @param fields The list of fields to read, or NULL for all of them.
+  /// @param results One vector of field/value pairs per key, in key order.
+  /// @param statuses The status of each key, in key order.
+  /// @return Zero if every record was read, or the last non-zero error code.
+  ///
+  virtual Status BatchRead(const std::string &table, const std::vector<std::string> &keys,
+                           const std::vector<std::string> *fields,
+                           std::vector<std::vector<Field>> &results, std::vector<Status> &statuses) {
+    Status s = kOK;
+    results.clear();
+    results.resize(keys.size());
+    statuses.assign(keys.size(), kOK);
+    for (size_t i = 0; i < keys.size(); i++) {
+      statuses[i] = Read(table, keys[i], fields, results[i]);
+      if (statuses[i] != kOK) {
+        s = statuses[i];
+      }
+    }
+    return s;
+  }
+  ///
+  /// Writes a batch of full records into the database.
+  /// The default implementation issues one Insert per key; bindings override
+  /// this to commit the whole batch at once.
+  ///
+  /// @param table The name of the table.
+  /// @param keys The keys of the records to write.
+  /// @param values One vector of field/value pairs per key, in key order.
+  /// @return Zero on success, or the last non-zero error code.
+  ///
+  virtual Status BatchWrite(const std::string &table, const std::vector<std::string> &keys,
+                            std::vector<std::vector<Field>> &values) {
+    Status s = kOK;
+    for (size_t i = 0; i < keys.size(); i++) {
+      Status ks = Insert(table, keys[i], values[i]);
+      if (ks != kOK) {
+        s = ks;
+      }
+    }
+    return s;
+  }
+
+  ///
+  /// Starts an offline bulk load on this DB instance.
+  /// Records are handed to BulkLoadPut in strictly increasing key order and
+  /// become visible only after FinishBulkLoad. Bindings that cannot build
+  /// their files offline keep the default and return kNotImplemented.
+  ///
+  /// @param table The name of the table.
+  /// @return Zero on success, a non-zero error code on error.
+  ///
+  virtual Status BeginBulkLoad(const std::string &table) {
+    return kNotImplemented;
+  }
+  ///
+  /// Adds one record to the bulk load started by BeginBulkLoad.
+  ///
+  /// @param table The name of the table.
+  /// @param key The key of the record, greater than every previous key.
+  /// @param values A vector of field/value pairs to insert in the record.
+  /// @return Zero on success, a non-zero error code on error.
+  ///
+  virtual Status BulkLoadPut(const std::string &table, const std::string &key,
+                             std::vector<Field> &values) {
+    return kNotImplemented;
+  }
+  ///
+  /// Publishes the records added since BeginBulkLoad.
+  ///
+  /// @param table The name of the table.
+  /// @return Zero on success, a non-zero error code on error.
+  ///
+  virtual Status FinishBulkLoad(const std::string &table) {
+    return kNotImplemented;
+  }
+
+  ///
+  /// Whether this DB instance collects engine counters, decided in Init.
+  /// If so, StartCounters is called before each measured operation and
+  /// ReadCounters after it, both on the thread that issued it.
+  ///
+  virtual bool CollectsCounters() const {
+    return false;
+  }
+  virtual void StartCounters() { }
+  ///
+  /// Fills counters with what the engine did since StartCounters.
+  ///
+  virtual void ReadCounters(EngineCounters &counters) { }
+
+  ///
+  /// Appends engine-wide statistics such as memtable size, compaction debt
+  /// and cache usage to stats. Called by the status thread while clients
+  /// run, so it must be thread safe and cope with the DB not being open.
+  /// The default appends nothing.
+  ///
+  virtual void SampleEngineStats(EngineStats &stats) { }
 
   virtual ~DB() { }
 
@@ -107,6 +316,12 @@ class DB {
   }
  protected:
   utils::Properties *props_;
+  // backs the views returned by the default ReadView
+  std::vector<Field> view_storage_;
+  // backs the rows visited by the default ScanVisit
+  std::vector<std::vector<Field>> scan_storage_;
+  // row handed to a ScanVisitor, reused across rows and scans
+  std::vector<FieldView> scan_row_;
 };
 
 } // ycsbc
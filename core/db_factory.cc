@@ -23,14 +23,36 @@ bool DBFactory::RegisterDB(std::string db_name, DBCreator db_creator) {
   return true;
 }
 
-DB *DBFactory::CreateDB(utils::Properties *props, Measurements *measurements, int warmup_ops) {
+namespace {
+  // picks the wrapper for the concrete type of the measurements, so that
+  // reporting an operation is not a virtual call
+  DB *WrapDB(DB *db, Measurements *measurements, const std::atomic<bool> *measuring,
+             const SamplePeriods &sample_periods, TraceWriter *trace) {
+    if (auto *basic = dynamic_cast<BasicMeasurements *>(measurements)) {
+      return new MeasuredDBWrapper<BasicMeasurements>(db, basic, measuring, sample_periods, trace);
+    }
+#ifdef HDRMEASUREMENT
+    if (auto *hdr = dynamic_cast<HdrHistogramMeasurements *>(measurements)) {
+      return new MeasuredDBWrapper<HdrHistogramMeasurements>(db, hdr, measuring, sample_periods, trace);
+    }
+    if (auto *sharded = dynamic_cast<ShardedHdrHistogramMeasurements *>(measurements)) {
+      return new MeasuredDBWrapper<ShardedHdrHistogramMeasurements>(db, sharded, measuring, sample_periods,
+                                                                     trace);
+    }
+#endif
+    return new MeasuredDBWrapper<Measurements>(db, measurements, measuring, sample_periods, trace);
+  }
+} // anonymous
+
+DB *DBFactory::CreateDB(utils::Properties *props, Measurements *measurements,
+                        const std::atomic<bool> *measuring, TraceWriter *trace) {
   std::string db_name = props->GetProperty("dbname", "basic");
   DB *db = nullptr;
   std::map<std::string, DBCreator> &registry = Registry();
   if (registry.find(db_name) != registry.end()) {
     DB *new_db = (*registry[db_name])();
     new_db->SetProps(props);
-    db = new DBWrapper(new_db, measurements, warmup_ops);
+    db = WrapDB(new_db, measurements, measuring, GetSamplePeriods(*props), trace);
   }
   return db;
 }
@@ -13,16 +13,20 @@
 #include "measurements.h"
 #include "utils/properties.h"
 
+#include <atomic>
 #include <string>
 #include <map>
 
 namespace ycsbc {
 
+class TraceWriter;
+
 class DBFactory {
  public:
   using DBCreator = DB *(*)();
   static bool RegisterDB(std::string db_name, DBCreator db_creator);
-  static DB *CreateDB(utils::Properties *props, Measurements *measurements, int warmup_ops = 0);
+  static DB *CreateDB(utils::Properties *props, Measurements *measurements,
+                      const std::atomic<bool> *measuring = nullptr, TraceWriter *trace = nullptr);
  private:
   static std::map<std::string, DBCreator> &Registry();
 };
@@ -8,110 +8,368 @@
 #ifndef YCSB_C_DB_WRAPPER_H_
 #define YCSB_C_DB_WRAPPER_H_
 
+#include <algorithm>
+#include <chrono>
 #include <string>
 #include <vector>
 #include <atomic>
 
 #include "db.h"
 #include "measurements.h"
+#include "trace.h"
 #include "utils/timer.h"
 #include "utils/utils.h"
 
 namespace ycsbc {
 
+///
+/// Times the operations of a DB and reports them to the measurements. The
+/// operations themselves are in MeasuredDBWrapper; this part holds what does
+/// not depend on the type of the measurements.
+///
 class DBWrapper : public DB {
  public:
-  DBWrapper(DB *db, Measurements *measurements, int warmup_ops = 0) 
-    : db_(db), measurements_(measurements), warmup_ops_(warmup_ops), operation_count_(0) {}
+  using Clock = utils::Timer<uint64_t, std::nano>::Clock;
+
+  // Operations issued while *measuring is false are warmup and only counted;
+  // without a flag every operation is measured.
+  DBWrapper(DB *db, const std::atomic<bool> *measuring, const SamplePeriods &sample_periods,
+            TraceWriter *trace)
+    : db_(db), measuring_(measuring), sample_periods_(sample_periods), sample_calls_{}, trace_(trace),
+      tick_start_(0), tick_timed_(false), counters_(false) {
+    // calibrate the tick rate now rather than on the first operation
+    utils::TscClock::NanosPerTick();
+  }
   ~DBWrapper() {
+    if (trace_ != nullptr) {
+      trace_->AppendRun(trace_buffer_);
+    }
     delete db_;
   }
   void Init() {
     db_->Init();
+    counters_ = db_->CollectsCounters();
   }
   void Cleanup() {
     db_->Cleanup();
   }
-  
- private:  
-  void ReportOperation(Operation op, uint64_t latency) {
-    int current_op = operation_count_.fetch_add(1, std::memory_order_relaxed);
-    if (current_op < warmup_ops_) {
-      measurements_->ReportWarmup(op);
+  void SampleEngineStats(EngineStats &stats) {
+    db_->SampleEngineStats(stats);
+  }
+
+  ///
+  /// Sets the intended start time for operations issued by the calling thread.
+  /// Latency is then measured from this point instead of from the actual call,
+  /// so time spent queued behind a slow request is charged to the operation.
+  ///
+  static void SetIntendedStartTime(Clock::time_point t) {
+    IntendedStartTime() = t;
+  }
+  static void ClearIntendedStartTime() {
+    IntendedStartTime() = Clock::time_point();
+  }
+
+  ///
+  /// Marks the next batch issued by the calling thread as the requests of
+  /// independent logical clients, which became ready at the given times, one
+  /// per member. Every member is then charged the time from when its client
+  /// became ready until the batch completed, which is what that client
+  /// waited, instead of an amortized share. nullptr goes back to plain batches.
+  ///
+  static void SetMemberStartTimes(const std::vector<Clock::time_point> *starts) {
+    MemberStartTimes() = starts;
+  }
+
+  ///
+  /// Reports the operations of the current sample periods, which no timed
+  /// operation stands for yet, and releases the calling thread from the
+  /// measurements. Called by each client thread when it is done, so the
+  /// phase totals count every measured operation.
+  ///
+  virtual void FlushSamples() = 0;
+
+ protected:
+  static Clock::time_point &IntendedStartTime() {
+    static thread_local Clock::time_point intended_start;
+    return intended_start;
+  }
+  static const std::vector<Clock::time_point> *&MemberStartTimes() {
+    static thread_local const std::vector<Clock::time_point> *member_starts = nullptr;
+    return member_starts;
+  }
+
+  bool Measuring() const {
+    return measuring_ == nullptr || measuring_->load(std::memory_order_relaxed);
+  }
+
+  // Counts an operation of type op towards its sample period and returns
+  // the number of operations it stands for: the period if it is timed, 0 if
+  // it is not. Each client thread has its own wrapper, so no atomics.
+  uint32_t Sample(Operation op) {
+    if (++sample_calls_[op] < sample_periods_.period[op]) {
+      return 0;
+    }
+    sample_calls_[op] = 0;
+    return sample_periods_.period[op];
+  }
+
+  // The tick counter serves plain operations; an intended start time or a
+  // trace timestamp needs the clock.
+  void StartTimer() {
+    const Clock::time_point &intended_start = IntendedStartTime();
+    tick_timed_ = intended_start == Clock::time_point() && trace_ == nullptr;
+    if (tick_timed_) {
+      tick_start_ = utils::TscClock::Ticks();
     } else {
-      measurements_->Report(op, latency);
+      op_start_ = intended_start == Clock::time_point() ? Clock::now() : intended_start;
     }
   }
-  
+
+  uint64_t EndTimer() {
+    if (tick_timed_) {
+      return utils::TscClock::ToNanos(utils::TscClock::Ticks() - tick_start_);
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - op_start_).count();
+  }
+
+  // Appends the operation just timed to the trace being recorded, if any.
+  // Records are handed to the writer in runs of about 1MB.
+  void Record(Operation op, const std::string &key, const std::vector<Field> *values = nullptr,
+              int scan_length = 0) {
+    if (trace_ == nullptr) {
+      return;
+    }
+    uint32_t value_size = 0;
+    if (values != nullptr) {
+      for (const Field &field : *values) {
+        value_size += field.value.size();
+      }
+    }
+    uint64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::max(op_start_, trace_->start()) - trace_->start()).count();
+    TraceWriter::Encode(trace_buffer_, {timestamp, op, key, value_size,
+                                        static_cast<uint32_t>(scan_length)});
+    if (trace_buffer_.size() >= (1 << 20)) {
+      trace_->AppendRun(trace_buffer_);
+      trace_buffer_.clear();
+    }
+  }
+
+  DB *db_;
+  const std::atomic<bool> *measuring_;
+  const SamplePeriods sample_periods_;
+  uint32_t sample_calls_[MAXOPTYPE];
+  TraceWriter *trace_;
+  std::string trace_buffer_;
+  Clock::time_point op_start_;
+  uint64_t tick_start_;
+  bool tick_timed_;
+  // the DB collects engine counters
+  bool counters_;
+};
+
+///
+/// DBWrapper reporting to measurements of type M. With M one of the final
+/// Measurements classes, the reporting calls bind statically and inline.
+///
+template <typename M>
+class MeasuredDBWrapper final : public DBWrapper {
  public:
+  MeasuredDBWrapper(DB *db, M *measurements, const std::atomic<bool> *measuring,
+                    const SamplePeriods &sample_periods, TraceWriter *trace)
+    : DBWrapper(db, measuring, sample_periods, trace), measurements_(measurements), untimed_{} {}
+
   Status Read(const std::string &table, const std::string &key,
               const std::vector<std::string> *fields, std::vector<Field> &result) {
-    timer_.Start();
-    Status s = db_->Read(table, key, fields, result);
-    uint64_t elapsed = timer_.End();
-    
-    if (s == kOK) {
-      ReportOperation(READ, elapsed);
-    } else {
-      ReportOperation(READ_FAILED, elapsed);
-    }
+    Status s = Measure(READ, READ_FAILED, [&] { return db_->Read(table, key, fields, result); });
+    Record(READ, key);
+    return s;
+  }
+  Status ReadView(const std::string &table, const std::string &key,
+                  const std::vector<std::string> *fields, std::vector<FieldView> &result) {
+    Status s = Measure(READ, READ_FAILED, [&] { return db_->ReadView(table, key, fields, result); });
+    Record(READ, key);
     return s;
   }
   Status Scan(const std::string &table, const std::string &key, int record_count,
               const std::vector<std::string> *fields, std::vector<std::vector<Field>> &result) {
-    timer_.Start();
-    Status s = db_->Scan(table, key, record_count, fields, result);
-    uint64_t elapsed = timer_.End();
-    
-    if (s == kOK) {
-      ReportOperation(SCAN, elapsed);
-    } else {
-      ReportOperation(SCAN_FAILED, elapsed);
-    }
+    Status s = Measure(SCAN, SCAN_FAILED, [&] { return db_->Scan(table, key, record_count, fields, result); });
+    Record(SCAN, key, nullptr, record_count);
+    return s;
+  }
+  Status ScanVisit(const std::string &table, const std::string &key, int record_count,
+                   const std::vector<std::string> *fields, const ScanVisitor &visitor) {
+    Status s = Measure(SCAN, SCAN_FAILED, [&] {
+      return db_->ScanVisit(table, key, record_count, fields, visitor);
+    });
+    Record(SCAN, key, nullptr, record_count);
     return s;
   }
   Status Update(const std::string &table, const std::string &key, std::vector<Field> &values) {
-    timer_.Start();
-    Status s = db_->Update(table, key, values);
-    uint64_t elapsed = timer_.End();
-    
-    if (s == kOK) {
-      ReportOperation(UPDATE, elapsed);
-    } else {
-      ReportOperation(UPDATE_FAILED, elapsed);
-    }
+    Status s = Measure(UPDATE, UPDATE_FAILED, [&] { return db_->Update(table, key, values); });
+    Record(UPDATE, key, &values);
     return s;
   }
   Status Insert(const std::string &table, const std::string &key, std::vector<Field> &values) {
-    timer_.Start();
-    Status s = db_->Insert(table, key, values);
-    uint64_t elapsed = timer_.End();
-    
-    if (s == kOK) {
-      ReportOperation(INSERT, elapsed);
-    } else {
-      ReportOperation(INSERT_FAILED, elapsed);
-    }
+    Status s = Measure(INSERT, INSERT_FAILED, [&] { return db_->Insert(table, key, values); });
+    Record(INSERT, key, &values);
     return s;
   }
   Status Delete(const std::string &table, const std::string &key) {
-    timer_.Start();
-    Status s = db_->Delete(table, key);
-    uint64_t elapsed = timer_.End();
-    
-    if (s == kOK) {
-      ReportOperation(DELETE, elapsed);
-    } else {
-      ReportOperation(DELETE_FAILED, elapsed);
+    Status s = Measure(DELETE, DELETE_FAILED, [&] { return db_->Delete(table, key); });
+    Record(DELETE, key);
+    return s;
+  }
+  Status BeginBulkLoad(const std::string &table) {
+    return db_->BeginBulkLoad(table);
+  }
+  Status BulkLoadPut(const std::string &table, const std::string &key, std::vector<Field> &values) {
+    Status s = Measure(INSERT, INSERT_FAILED, [&] { return db_->BulkLoadPut(table, key, values); });
+    Record(INSERT, key, &values);
+    return s;
+  }
+  Status FinishBulkLoad(const std::string &table) {
+    return db_->FinishBulkLoad(table);
+  }
+  Status BatchRead(const std::string &table, const std::vector<std::string> &keys,
+                   const std::vector<std::string> *fields,
+                   std::vector<std::vector<Field>> &results, std::vector<Status> &statuses) {
+    if (counters_) {
+      db_->StartCounters();
+    }
+    StartTimer();
+    Status s = db_->BatchRead(table, keys, fields, results, statuses);
+    uint64_t elapsed = EndTimer();
+    for (const std::string &key : keys) {
+      Record(READ, key);
     }
+
+    ReportBatch(s == kOK ? BATCHREAD : BATCHREAD_FAILED, READ, READ_FAILED, elapsed, statuses);
     return s;
   }
+  void FlushSamples() {
+    for (int op = 0; op < MAXOPTYPE; op++) {
+      if (untimed_[op] > 0) {
+        measurements_->ReportUnsampled(static_cast<Operation>(op), untimed_[op]);
+        untimed_[op] = 0;
+      }
+      sample_calls_[op] = 0;
+    }
+    measurements_->ReleaseThread();
+  }
+  Status BatchWrite(const std::string &table, const std::vector<std::string> &keys,
+                    std::vector<std::vector<Field>> &values) {
+    if (counters_) {
+      db_->StartCounters();
+    }
+    StartTimer();
+    Status s = db_->BatchWrite(table, keys, values);
+    uint64_t elapsed = EndTimer();
+    for (size_t i = 0; i < keys.size(); i++) {
+      Record(INSERT, keys[i], &values[i]);
+    }
+
+    // a batch write commits or fails as a whole
+    batch_statuses_.assign(keys.size(), s);
+    ReportBatch(s == kOK ? BATCHWRITE : BATCHWRITE_FAILED, INSERT, INSERT_FAILED, elapsed, batch_statuses_);
+    return s;
+  }
+
  private:
-  DB *db_;
-  Measurements *measurements_;
-  utils::Timer<uint64_t, std::nano> timer_;
-  int warmup_ops_;
-  std::atomic<int> operation_count_;
+  // Runs one operation and accounts for it. Warmup operations are only
+  // counted; otherwise one in a sample period is timed and reported for the
+  // whole period and the others run untimed. A trace needs the start time of
+  // every operation, so all of them are timed while one is recorded.
+  template <typename Call>
+  Status Measure(Operation op, Operation failed_op, Call call) {
+    if (!Measuring()) {
+      if (trace_ != nullptr) {
+        StartTimer();
+      }
+      Status s = call();
+      measurements_->ReportWarmup(s == kOK ? op : failed_op);
+      return s;
+    }
+    const uint32_t count = trace_ == nullptr ? Sample(op) : 1;
+    if (count == 0) {
+      Status s = call();
+      untimed_[s == kOK ? op : failed_op]++;
+      return s;
+    }
+    if (counters_) {
+      db_->StartCounters();
+    }
+    StartTimer();
+    Status s = call();
+    uint64_t elapsed = EndTimer();
+    // the timed operation stands for the untimed ones of its period that
+    // ended the same way; the others are only counted
+    const Operation timed_op = s == kOK ? op : failed_op;
+    const Operation other_op = s == kOK ? failed_op : op;
+    const uint64_t weight = 1 + untimed_[timed_op];
+    measurements_->Report(timed_op, elapsed, weight);
+    ReportCounters(timed_op, weight);
+    if (untimed_[other_op] > 0) {
+      measurements_->ReportUnsampled(other_op, untimed_[other_op]);
+    }
+    untimed_[timed_op] = 0;
+    untimed_[other_op] = 0;
+    return s;
+  }
+
+  // Reports the engine counters of the operation just timed, read after the
+  // timer stopped so collecting them does not add to its latency.
+  void ReportCounters(Operation op, uint64_t count) {
+    if (!counters_) {
+      return;
+    }
+    EngineCounters counters = {};
+    db_->ReadCounters(counters);
+    measurements_->ReportCounters(op, counters, count);
+  }
+
+  // Reports the batch latency once, and a latency for each member operation
+  // so per-op counts and throughput stay comparable: the amortized share of
+  // a plain batch, or for the requests of logical clients, the time since
+  // each one's client became ready. A member counts as failed_op if its own
+  // status is not kOK.
+  void ReportBatch(Operation batch_op, Operation op, Operation failed_op, uint64_t latency,
+                   const std::vector<Status> &statuses) {
+    const size_t n = statuses.size();
+    if (n == 0) {
+      return;
+    }
+    if (!Measuring()) {
+      for (Status s : statuses) {
+        measurements_->ReportWarmup(s == kOK ? op : failed_op);
+      }
+      return;
+    }
+    const std::vector<Clock::time_point> *starts = MemberStartTimes();
+    if (starts != nullptr && starts->size() == n) {
+      const Clock::time_point end = Clock::now();
+      for (size_t i = 0; i < n; i++) {
+        uint64_t member_latency = std::chrono::duration_cast<std::chrono::nanoseconds>(end - (*starts)[i]).count();
+        measurements_->Report(statuses[i] == kOK ? op : failed_op, member_latency, 1);
+      }
+    } else {
+      const size_t failed = n - std::count(statuses.begin(), statuses.end(), kOK);
+      if (failed < n) {
+        measurements_->Report(op, latency / n, n - failed);
+      }
+      if (failed > 0) {
+        measurements_->Report(failed_op, latency / n, failed);
+      }
+    }
+    measurements_->Report(batch_op, latency, 1);
+    ReportCounters(batch_op, 1);
+  }
+
+  M *measurements_;
+  // operations of the current sample periods that ran untimed, by the
+  // operation type they ended as
+  uint32_t untimed_[MAXOPTYPE];
+  std::vector<Status> batch_statuses_;
 };
 
 } // ycsbc
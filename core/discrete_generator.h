@@ -11,26 +11,31 @@
 
 #include "generator.h"
 
-#include <atomic>
 #include <cassert>
 #include <vector>
-#include "utils/utils.h"
+#include "utils/random.h"
 
 namespace ycsbc {
 
 template <typename Value>
 class DiscreteGenerator : public Generator<Value> {
  public:
-  DiscreteGenerator() : sum_(0) { }
+  DiscreteGenerator() : sum_(0), last_() { }
   void AddValue(Value value, double weight);
 
   Value Next();
   Value Last() { return last_; }
+  DiscreteGenerator<Value> *Clone(uint64_t seed) const override {
+    DiscreteGenerator<Value> *clone = new DiscreteGenerator<Value>(*this);
+    clone->rng_.Seed(seed);
+    return clone;
+  }
 
  private:
   std::vector<std::pair<Value, double>> values_;
   double sum_;
-  std::atomic<Value> last_;
+  Value last_;
+  utils::Xoshiro256 rng_;
 };
 
 template <typename Value>
@@ -44,7 +49,7 @@ inline void DiscreteGenerator<Value>::AddValue(Value value, double weight) {
 
 template <typename Value>
 inline Value DiscreteGenerator<Value>::Next() {
-  double chooser = utils::ThreadLocalRandomDouble();
+  double chooser = rng_.NextDouble();
 
   for (auto p = values_.cbegin(); p != values_.cend(); ++p) {
     if (chooser < p->second / sum_) {
@@ -18,6 +18,12 @@ class Generator {
  public:
   virtual Value Next() = 0;
   virtual Value Last() = 0;
+  ///
+  /// Returns an independent copy for use by a single thread, with its random
+  /// stream seeded by seed. Generators whose state must stay shared between
+  /// threads (counters) cannot be cloned and return nullptr.
+  ///
+  virtual Generator<Value> *Clone(uint64_t seed) const { return nullptr; }
   virtual ~Generator() { }
 };
 
@@ -0,0 +1,103 @@
+//
+//  hotspot_shift_generator.h
+//  YCSB-cpp
+//
+
+#ifndef YCSB_C_HOTSPOT_SHIFT_GENERATOR_H_
+#define YCSB_C_HOTSPOT_SHIFT_GENERATOR_H_
+
+#include "generator.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include "utils/utils.h"
+
+namespace ycsbc {
+
+///
+/// Moves the keys drawn by another generator through the key space over time,
+/// so that its hot set drifts. Keys below key_space are rotated by an offset
+/// that, every interval seconds, either slides on by one window (kSlide,
+/// continuously in between) or jumps to a new random position (kJump).
+/// Keys at or above key_space (inserted during the run) are left alone.
+///
+/// The schedule starts with the first key drawn by any clone, and all clones
+/// follow the same offsets.
+///
+class HotspotShiftGenerator : public Generator<uint64_t> {
+ public:
+  enum Mode {
+    kSlide,
+    kJump
+  };
+
+  // takes ownership of base
+  HotspotShiftGenerator(Generator<uint64_t> *base, uint64_t key_space, uint64_t window,
+                        double interval, Mode mode, uint64_t seed)
+      : base_(base), key_space_(key_space), window_(window), mode_(mode), seed_(seed),
+        interval_ns_(interval * 1e9), start_(std::make_shared<std::atomic<int64_t>>(0)),
+        calls_(0), offset_(0), last_(0) { }
+
+  HotspotShiftGenerator(const HotspotShiftGenerator &other, Generator<uint64_t> *base)
+      : base_(base), key_space_(other.key_space_), window_(other.window_), mode_(other.mode_),
+        seed_(other.seed_), interval_ns_(other.interval_ns_), start_(other.start_),
+        calls_(0), offset_(0), last_(0) { }
+
+  uint64_t Next() override;
+  uint64_t Last() override { return last_; }
+  HotspotShiftGenerator *Clone(uint64_t seed) const override {
+    Generator<uint64_t> *base = base_->Clone(seed);
+    return base == nullptr ? nullptr : new HotspotShiftGenerator(*this, base);
+  }
+
+ private:
+  // the clock is read once per this many keys
+  static const uint64_t kUpdatePeriod = 256;
+
+  void UpdateOffset();
+
+  std::unique_ptr<Generator<uint64_t>> base_;
+  uint64_t key_space_;
+  uint64_t window_;
+  Mode mode_;
+  uint64_t seed_;
+  double interval_ns_;
+  // nanoseconds since the clock epoch, shared with the clones; 0 until started
+  std::shared_ptr<std::atomic<int64_t>> start_;
+  uint64_t calls_;
+  uint64_t offset_;
+  uint64_t last_;
+};
+
+inline void HotspotShiftGenerator::UpdateOffset() {
+  int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  int64_t start = start_->load(std::memory_order_relaxed);
+  if (start == 0) {
+    start = start_->compare_exchange_strong(start, now) ? now : start;
+  }
+  double intervals = (now - start) / interval_ns_;
+  if (mode_ == kSlide) {
+    offset_ = static_cast<uint64_t>(intervals * window_) % key_space_;
+  } else {
+    uint64_t epoch = static_cast<uint64_t>(intervals);
+    offset_ = epoch == 0 ? 0 : utils::FNVHash64(seed_ ^ epoch) % key_space_;
+  }
+}
+
+inline uint64_t HotspotShiftGenerator::Next() {
+  if (calls_++ % kUpdatePeriod == 0) {
+    UpdateOffset();
+  }
+  uint64_t key = base_->Next();
+  if (key < key_space_) {
+    key = (key + offset_) % key_space_;
+  }
+  return last_ = key;
+}
+
+} // ycsbc
+
+#endif // YCSB_C_HOTSPOT_SHIFT_GENERATOR_H_
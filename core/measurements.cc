@@ -8,9 +8,17 @@
 #include "measurements.h"
 #include "utils/utils.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <limits>
 #include <numeric>
 #include <sstream>
+#include <utility>
+
+#ifdef HDRMEASUREMENT
+#include <hdr/hdr_histogram_log.h>
+#endif
 
 namespace {
   const std::string MEASUREMENT_TYPE = "measurementtype";
@@ -19,17 +27,87 @@ namespace {
 #else
   const std::string MEASUREMENT_TYPE_DEFAULT = "basic";
 #endif
+
+  const std::string MEASUREMENT_SAMPLE_RATE = "measurement.sample_rate";
+  const std::string MEASUREMENT_SAMPLE_RATE_DEFAULT = "1";
 } // anonymous
 
 namespace ycsbc {
 
-BasicMeasurements::BasicMeasurements() : count_{}, latency_sum_{}, latency_max_{}, warmup_count_{}, total_warmup_ops_(0) {
+Measurements::Measurements() : counters_{}, unsampled_{} { }
+
+void Measurements::ReportCounters(Operation op, const EngineCounters &counters, uint64_t count) {
+  CounterSums &sums = counters_[op];
+  sums.ops.fetch_add(count, std::memory_order_relaxed);
+  for (int i = 0; i < MAXCOUNTER; i++) {
+    if (counters.value[i] != 0) {
+      sums.sum[i].fetch_add(counters.value[i] * count, std::memory_order_relaxed);
+    }
+  }
+}
+
+std::string Measurements::GetCounterMsg() const {
+  std::ostringstream msg_stream;
+  msg_stream.precision(2);
+  msg_stream << std::fixed;
+  for (int op = 0; op < MAXOPTYPE; op++) {
+    uint64_t ops = counters_[op].ops.load(std::memory_order_relaxed);
+    if (ops == 0) {
+      continue;
+    }
+    msg_stream << "\n[" << kOperationString[op] << " per op:";
+    for (int i = 0; i < MAXCOUNTER; i++) {
+      msg_stream << " " << kEngineCounterString[i] << "="
+                 << static_cast<double>(counters_[op].sum[i].load(std::memory_order_relaxed)) / ops;
+    }
+    msg_stream << "]";
+  }
+  return msg_stream.str();
+}
+
+void Measurements::FillCounters(OpStats stats[MAXOPTYPE]) const {
+  for (int op = 0; op < MAXOPTYPE; op++) {
+    stats[op].counter_ops = counters_[op].ops.load(std::memory_order_relaxed);
+    for (int i = 0; i < MAXCOUNTER; i++) {
+      stats[op].counters[i] = counters_[op].sum[i].load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void Measurements::ResetCounters() {
+  for (int op = 0; op < MAXOPTYPE; op++) {
+    counters_[op].ops.store(0, std::memory_order_relaxed);
+    for (int i = 0; i < MAXCOUNTER; i++) {
+      counters_[op].sum[i].store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+void Measurements::ReportUnsampled(Operation op, uint64_t count) {
+  unsampled_[op].fetch_add(count, std::memory_order_relaxed);
+}
+
+void Measurements::FillUnsampled(OpStats stats[MAXOPTYPE]) const {
+  for (int op = 0; op < MAXOPTYPE; op++) {
+    stats[op].count += unsampled_[op].load(std::memory_order_relaxed);
+  }
+}
+
+void Measurements::ResetUnsampled() {
+  std::fill(std::begin(unsampled_), std::end(unsampled_), 0);
+}
+
+BasicMeasurements::BasicMeasurements() : count_{}, latency_sum_{}, latency_sq_sum_{}, latency_max_{}, warmup_count_{}, total_warmup_ops_(0),
+                                         last_count_{}, last_latency_sum_{} {
   std::fill(std::begin(latency_min_), std::end(latency_min_), std::numeric_limits<uint64_t>::max());
 }
 
-void BasicMeasurements::Report(Operation op, uint64_t latency) {
-  count_[op].fetch_add(1, std::memory_order_relaxed);
-  latency_sum_[op].fetch_add(latency, std::memory_order_relaxed);
+void BasicMeasurements::Report(Operation op, uint64_t latency, uint64_t count) {
+  count_[op].fetch_add(count, std::memory_order_relaxed);
+  latency_sum_[op].fetch_add(latency * count, std::memory_order_relaxed);
+  const double sq = static_cast<double>(latency) * latency * count;
+  double prev_sq_sum = latency_sq_sum_[op].load(std::memory_order_relaxed);
+  while (!latency_sq_sum_[op].compare_exchange_weak(prev_sq_sum, prev_sq_sum + sq, std::memory_order_relaxed));
   uint64_t prev_min = latency_min_[op].load(std::memory_order_relaxed);
   while (prev_min > latency
          && !latency_min_[op].compare_exchange_weak(prev_min, latency, std::memory_order_relaxed));
@@ -81,30 +159,139 @@ std::string BasicMeasurements::GetStatusMsg() {
                    ? static_cast<double>(latency_sum_[op].load(std::memory_order_relaxed)) / cnt
                    : 0) / 1000.0
                << "]";
-    total_cnt += cnt;
+    if (!IsBatchOperation(op)) {
+      total_cnt += cnt;
+    }
+  }
+  return std::to_string(total_cnt) + msg_stream.str() + GetCounterMsg();
+}
+
+void BasicMeasurements::GetIntervalStats(IntervalStats stats[MAXOPTYPE]) {
+  // min/max are only tracked cumulatively, so intervals carry count and mean
+  for (int op = 0; op < MAXOPTYPE; op++) {
+    uint64_t cnt = count_[op].load(std::memory_order_relaxed);
+    uint64_t sum = latency_sum_[op].load(std::memory_order_relaxed);
+    IntervalStats &st = stats[op];
+    st = IntervalStats();
+    st.count = cnt - last_count_[op];
+    st.avg = st.count > 0 ? static_cast<double>(sum - last_latency_sum_[op]) / st.count : 0;
+    last_count_[op] = cnt;
+    last_latency_sum_[op] = sum;
+  }
+}
+
+void BasicMeasurements::GetOpStats(OpStats stats[MAXOPTYPE]) {
+  for (int op = 0; op < MAXOPTYPE; op++) {
+    OpStats &st = stats[op];
+    st = OpStats();
+    st.count = count_[op].load(std::memory_order_relaxed);
+    st.timed_count = st.count;
+    if (st.count == 0) {
+      continue;
+    }
+    st.min = latency_min_[op].load(std::memory_order_relaxed);
+    st.max = latency_max_[op].load(std::memory_order_relaxed);
+    st.mean = static_cast<double>(latency_sum_[op].load(std::memory_order_relaxed)) / st.count;
+    double variance = latency_sq_sum_[op].load(std::memory_order_relaxed) / st.count - st.mean * st.mean;
+    st.stddev = std::sqrt(std::max(variance, 0.0));
   }
-  return std::to_string(total_cnt) + msg_stream.str();
+  FillCounters(stats);
+  FillUnsampled(stats);
 }
 
 void BasicMeasurements::Reset() {
+  std::fill(std::begin(last_count_), std::end(last_count_), 0);
+  std::fill(std::begin(last_latency_sum_), std::end(last_latency_sum_), 0);
   std::fill(std::begin(count_), std::end(count_), 0);
   std::fill(std::begin(latency_sum_), std::end(latency_sum_), 0);
+  std::fill(std::begin(latency_sq_sum_), std::end(latency_sq_sum_), 0.0);
   std::fill(std::begin(latency_min_), std::end(latency_min_), std::numeric_limits<uint64_t>::max());
   std::fill(std::begin(latency_max_), std::end(latency_max_), 0);
   std::fill(std::begin(warmup_count_), std::end(warmup_count_), 0);
+  ResetCounters();
+  ResetUnsampled();
 }
 
 #ifdef HDRMEASUREMENT
+namespace {
+  void FillIntervalStats(const hdr_histogram *h, IntervalStats *stats) {
+    *stats = IntervalStats();
+    stats->count = h->total_count;
+    if (stats->count == 0) {
+      return;
+    }
+    stats->avg = hdr_mean(h);
+    stats->has_percentiles = true;
+    stats->min = hdr_min(h);
+    stats->max = hdr_max(h);
+    stats->p50 = hdr_value_at_percentile(h, 50);
+    stats->p90 = hdr_value_at_percentile(h, 90);
+    stats->p99 = hdr_value_at_percentile(h, 99);
+    stats->p999 = hdr_value_at_percentile(h, 99.9);
+  }
+
+  // steps per halving of the distance to 100%, as in HdrHistogram's
+  // percentile output
+  const int32_t kPercentileTicksPerHalfDistance = 5;
+
+  void FillOpStats(hdr_histogram *h, OpStats *stats) {
+    *stats = OpStats();
+    stats->count = h->total_count;
+    stats->timed_count = h->total_count;
+    if (stats->count == 0) {
+      return;
+    }
+    stats->min = hdr_min(h);
+    stats->max = hdr_max(h);
+    stats->mean = hdr_mean(h);
+    stats->stddev = hdr_stddev(h);
+    hdr_iter iter;
+    hdr_iter_percentile_init(&iter, h, kPercentileTicksPerHalfDistance);
+    while (hdr_iter_next(&iter)) {
+      // the last bucket reaches past the largest value recorded
+      stats->percentiles.emplace_back(iter.specifics.percentiles.percentile,
+                                      std::min<int64_t>(iter.highest_equivalent_value, stats->max));
+    }
+    char *encoded = nullptr;
+    if (hdr_log_encode(h, &encoded) != 0) {
+      throw utils::Exception("hdr encode failed");
+    }
+    stats->histogram = encoded;
+    std::free(encoded);
+  }
+} // anonymous
+
 HdrHistogramMeasurements::HdrHistogramMeasurements() : warmup_count_{}, total_warmup_ops_(0) {
   for (int op = 0; op < MAXOPTYPE; op++) {
-    if (hdr_init(10, 100LL * 1000 * 1000 * 1000, 3, &histogram_[op]) != 0) {
-      utils::Exception("hdr init failed");
+    if (hdr_interval_recorder_init_all(&recorder_[op], 10, 100LL * 1000 * 1000 * 1000, 3) != 0 ||
+        hdr_init(10, 100LL * 1000 * 1000 * 1000, 3, &histogram_[op]) != 0 ||
+        hdr_init(10, 100LL * 1000 * 1000 * 1000, 3, &interval_[op]) != 0) {
+      throw utils::Exception("hdr init failed");
     }
   }
 }
 
-void HdrHistogramMeasurements::Report(Operation op, uint64_t latency) {
-  hdr_record_value_atomic(histogram_[op], latency);
+HdrHistogramMeasurements::~HdrHistogramMeasurements() {
+  for (int op = 0; op < MAXOPTYPE; op++) {
+    hdr_interval_recorder_destroy(&recorder_[op]);
+    hdr_close(histogram_[op]);
+    hdr_close(interval_[op]);
+  }
+}
+
+void HdrHistogramMeasurements::Report(Operation op, uint64_t latency, uint64_t count) {
+  hdr_interval_recorder_record_values_atomic(&recorder_[op], latency, count);
+}
+
+void HdrHistogramMeasurements::Sample() {
+  for (int op = 0; op < MAXOPTYPE; op++) {
+    hdr_histogram *sample = hdr_interval_recorder_sample(&recorder_[op]);
+    if (sample->total_count == 0) {
+      continue;
+    }
+    hdr_add(histogram_[op], sample);
+    hdr_add(interval_[op], sample);
+  }
 }
 
 void HdrHistogramMeasurements::ReportWarmup(Operation op) {
@@ -120,6 +307,9 @@ std::string HdrHistogramMeasurements::GetStatusMsg() {
   msg_stream.precision(2);
   uint64_t total_cnt = 0;
   uint64_t total_warmup_cnt = 0;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  Sample();
   
   msg_stream << std::fixed << " operations;";
 
@@ -151,16 +341,214 @@ std::string HdrHistogramMeasurements::GetStatusMsg() {
                << " 99.9=" << hdr_value_at_percentile(histogram_[op], 99.9) / 1000.0
                << " 99.99=" << hdr_value_at_percentile(histogram_[op], 99.99) / 1000.0
                << "]";
-    total_cnt += cnt;
+    if (!IsBatchOperation(op)) {
+      total_cnt += cnt;
+    }
   }
-  return std::to_string(total_cnt) + msg_stream.str();
+  return std::to_string(total_cnt) + msg_stream.str() + GetCounterMsg();
+}
+
+void HdrHistogramMeasurements::GetIntervalStats(IntervalStats stats[MAXOPTYPE]) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Sample();
+  for (int op = 0; op < MAXOPTYPE; op++) {
+    FillIntervalStats(interval_[op], &stats[op]);
+    hdr_reset(interval_[op]);
+  }
+}
+
+void HdrHistogramMeasurements::GetOpStats(OpStats stats[MAXOPTYPE]) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Sample();
+  for (int op = 0; op < MAXOPTYPE; op++) {
+    FillOpStats(histogram_[op], &stats[op]);
+  }
+  FillCounters(stats);
+  FillUnsampled(stats);
 }
 
 void HdrHistogramMeasurements::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Sample();
   for (int op = 0; op < MAXOPTYPE; op++) {
     hdr_reset(histogram_[op]);
+    hdr_reset(interval_[op]);
   }
   std::fill(std::begin(warmup_count_), std::end(warmup_count_), 0);
+  ResetCounters();
+  ResetUnsampled();
+}
+
+namespace {
+  std::atomic<uint64_t> sharded_measurements_id{0};
+} // anonymous
+
+thread_local uint64_t ShardedHdrHistogramMeasurements::cached_id_ = 0;
+thread_local ShardedHdrHistogramMeasurements::Shard *ShardedHdrHistogramMeasurements::cached_shard_ = nullptr;
+
+ShardedHdrHistogramMeasurements::ShardedHdrHistogramMeasurements()
+    : id_(sharded_measurements_id.fetch_add(1) + 1), total_warmup_ops_(0) {
+  for (int op = 0; op < MAXOPTYPE; op++) {
+    if (hdr_init(10, 100LL * 1000 * 1000 * 1000, 3, &histogram_[op]) != 0 ||
+        hdr_init(10, 100LL * 1000 * 1000 * 1000, 3, &interval_[op]) != 0) {
+      throw utils::Exception("hdr init failed");
+    }
+  }
+}
+
+ShardedHdrHistogramMeasurements::~ShardedHdrHistogramMeasurements() {
+  for (auto &shard : shards_) {
+    for (int op = 0; op < MAXOPTYPE; op++) {
+      hdr_interval_recorder_destroy(&shard->recorder[op]);
+    }
+  }
+  for (int op = 0; op < MAXOPTYPE; op++) {
+    hdr_close(histogram_[op]);
+    hdr_close(interval_[op]);
+  }
+}
+
+ShardedHdrHistogramMeasurements::Shard *ShardedHdrHistogramMeasurements::NewShard() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!free_shards_.empty()) {
+    Shard *shard = free_shards_.back();
+    free_shards_.pop_back();
+    return shard;
+  }
+  std::unique_ptr<Shard> shard(new Shard());
+  for (int op = 0; op < MAXOPTYPE; op++) {
+    if (hdr_interval_recorder_init_all(&shard->recorder[op], 10, 100LL * 1000 * 1000 * 1000, 3) != 0) {
+      throw utils::Exception("hdr init failed");
+    }
+    shard->warmup_count[op].store(0, std::memory_order_relaxed);
+  }
+  shards_.push_back(std::move(shard));
+  return shards_.back().get();
+}
+
+inline ShardedHdrHistogramMeasurements::Shard *ShardedHdrHistogramMeasurements::GetShard() {
+  if (cached_id_ != id_) {
+    cached_shard_ = NewShard();
+    cached_id_ = id_;
+  }
+  return cached_shard_;
+}
+
+void ShardedHdrHistogramMeasurements::ReleaseThread() {
+  if (cached_id_ != id_) {
+    return;
+  }
+  // the shard keeps what it recorded; the next thread adds to it
+  std::lock_guard<std::mutex> lock(mutex_);
+  free_shards_.push_back(cached_shard_);
+  cached_id_ = 0;
+  cached_shard_ = nullptr;
+}
+
+void ShardedHdrHistogramMeasurements::Report(Operation op, uint64_t latency, uint64_t count) {
+  // one writer per recorder, so the phaser alone keeps it safe against Sample()
+  hdr_interval_recorder_record_values(&GetShard()->recorder[op], latency, count);
+}
+
+void ShardedHdrHistogramMeasurements::ReportWarmup(Operation op) {
+  GetShard()->warmup_count[op].fetch_add(1, std::memory_order_relaxed);
+}
+
+void ShardedHdrHistogramMeasurements::SetWarmupTarget(int total_warmup_ops) {
+  total_warmup_ops_.store(total_warmup_ops, std::memory_order_relaxed);
+}
+
+uint64_t ShardedHdrHistogramMeasurements::Sample() {
+  uint64_t total_warmup_cnt = 0;
+  for (auto &shard : shards_) {
+    for (int op = 0; op < MAXOPTYPE; op++) {
+      total_warmup_cnt += shard->warmup_count[op].load(std::memory_order_relaxed);
+      hdr_histogram *sample = hdr_interval_recorder_sample(&shard->recorder[op]);
+      if (sample->total_count == 0) {
+        continue;
+      }
+      hdr_add(histogram_[op], sample);
+      hdr_add(interval_[op], sample);
+    }
+  }
+  return total_warmup_cnt;
+}
+
+std::string ShardedHdrHistogramMeasurements::GetStatusMsg() {
+  std::ostringstream msg_stream;
+  msg_stream.precision(2);
+  uint64_t total_cnt = 0;
+  uint64_t total_warmup_cnt = 0;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  total_warmup_cnt = Sample();
+  total_cnt += total_warmup_cnt;
+
+  msg_stream << std::fixed << " operations;";
+
+  int target_warmup = total_warmup_ops_.load(std::memory_order_relaxed);
+  if (target_warmup > 0 && total_warmup_cnt < static_cast<uint64_t>(target_warmup)) {
+    double warmup_progress = (double)total_warmup_cnt / target_warmup * 100.0;
+    msg_stream << " warmup: " << total_warmup_cnt << "/" << target_warmup 
+               << " (" << warmup_progress << "%);";
+  }
+
+  for (int i = 0; i < MAXOPTYPE; i++) {
+    Operation op = static_cast<Operation>(i);
+    uint64_t cnt = histogram_[op]->total_count;
+    if (cnt == 0)
+      continue;
+    msg_stream << "\n[" << kOperationString[op] << ":"
+               << " Count=" << cnt
+               << " Max=" << hdr_max(histogram_[op]) / 1000.0
+               << " Min=" << hdr_min(histogram_[op]) / 1000.0
+               << " Avg=" << hdr_mean(histogram_[op]) / 1000.0
+               << " 90=" << hdr_value_at_percentile(histogram_[op], 90) / 1000.0
+               << " 99=" << hdr_value_at_percentile(histogram_[op], 99) / 1000.0
+               << " 99.9=" << hdr_value_at_percentile(histogram_[op], 99.9) / 1000.0
+               << " 99.99=" << hdr_value_at_percentile(histogram_[op], 99.99) / 1000.0
+               << "]";
+    if (!IsBatchOperation(op)) {
+      total_cnt += cnt;
+    }
+  }
+  return std::to_string(total_cnt) + msg_stream.str() + GetCounterMsg();
+}
+
+void ShardedHdrHistogramMeasurements::GetIntervalStats(IntervalStats stats[MAXOPTYPE]) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Sample();
+  for (int op = 0; op < MAXOPTYPE; op++) {
+    FillIntervalStats(interval_[op], &stats[op]);
+    hdr_reset(interval_[op]);
+  }
+}
+
+void ShardedHdrHistogramMeasurements::GetOpStats(OpStats stats[MAXOPTYPE]) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Sample();
+  for (int op = 0; op < MAXOPTYPE; op++) {
+    FillOpStats(histogram_[op], &stats[op]);
+  }
+  FillCounters(stats);
+  FillUnsampled(stats);
+}
+
+void ShardedHdrHistogramMeasurements::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // what the shards recorded so far is sampled out and dropped
+  Sample();
+  for (auto &shard : shards_) {
+    for (int op = 0; op < MAXOPTYPE; op++) {
+      shard->warmup_count[op].store(0, std::memory_order_relaxed);
+    }
+  }
+  for (int op = 0; op < MAXOPTYPE; op++) {
+    hdr_reset(histogram_[op]);
+    hdr_reset(interval_[op]);
+  }
+  ResetCounters();
+  ResetUnsampled();
 }
 #endif
 
@@ -173,6 +561,8 @@ Measurements *CreateMeasurements(utils::Properties *props) {
 #ifdef HDRMEASUREMENT
   } else if (name == "hdrhistogram") {
     measurements = new HdrHistogramMeasurements();
+  } else if (name == "shardedhdrhistogram") {
+    measurements = new ShardedHdrHistogramMeasurements();
 #endif
   } else {
     measurements = nullptr;
@@ -181,4 +571,19 @@ Measurements *CreateMeasurements(utils::Properties *props) {
   return measurements;
 }
 
+SamplePeriods GetSamplePeriods(const utils::Properties &props) {
+  const std::string default_rate = props.GetProperty(MEASUREMENT_SAMPLE_RATE, MEASUREMENT_SAMPLE_RATE_DEFAULT);
+  SamplePeriods periods;
+  for (int op = 0; op < MAXOPTYPE; op++) {
+    const std::string rate_str = props.GetProperty(MEASUREMENT_SAMPLE_RATE + "." + kOperationString[op],
+                                                   default_rate);
+    double rate = std::stod(rate_str);
+    if (rate <= 0 || rate > 1) {
+      throw utils::Exception("sample rate must be in (0, 1]: " + rate_str);
+    }
+    periods.period[op] = static_cast<uint32_t>(std::lround(1 / rate));
+  }
+  return periods;
+}
+
 } // ycsbc
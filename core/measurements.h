@@ -12,59 +12,224 @@
 #include "utils/properties.h"
 
 #include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
 
 #ifdef HDRMEASUREMENT
 #include <hdr/hdr_histogram.h>
+#include <hdr/hdr_interval_recorder.h>
 #endif
 
 typedef unsigned int uint;
 
 namespace ycsbc {
 
+///
+/// Latency statistics of one operation type over a single status interval.
+/// Latencies are in nanoseconds; percentiles are only filled in by
+/// histogram based measurements.
+///
+struct IntervalStats {
+  uint64_t count;
+  double avg;
+  bool has_percentiles;
+  uint64_t min;
+  uint64_t max;
+  uint64_t p50;
+  uint64_t p90;
+  uint64_t p99;
+  uint64_t p999;
+};
+
+///
+/// Latency statistics of one operation type since the last Reset, for the
+/// final report. Latencies are in nanoseconds. percentiles holds the
+/// log-linear percentile spectrum as (percentile, latency) pairs and
+/// histogram the base64 encoded, compressed HdrHistogram; both are left empty
+/// by measurements without a histogram. counters sums the engine counters of
+/// the counter_ops operations that had them. count includes the operations
+/// that were measured but not timed; the latencies stand for timed_count of
+/// them, and are unset when it is 0.
+///
+struct OpStats {
+  uint64_t count;
+  uint64_t timed_count;
+  uint64_t min;
+  uint64_t max;
+  double mean;
+  double stddev;
+  std::vector<std::pair<double, uint64_t>> percentiles;
+  std::string histogram;
+  uint64_t counter_ops;
+  uint64_t counters[MAXCOUNTER];
+};
+
 class Measurements {
  public:
-  virtual void Report(Operation op, uint64_t latency) = 0;
+  ///
+  /// Reports count operations of type op that took latency nanoseconds each;
+  /// more than one for a sampled operation or the members of a batch.
+  ///
+  virtual void Report(Operation op, uint64_t latency, uint64_t count) = 0;
+  virtual ~Measurements() { }
   virtual void ReportWarmup(Operation op) = 0;
   virtual std::string GetStatusMsg() = 0;
+  ///
+  /// Fills stats[op] with the operations reported since the previous call
+  /// (or since the last Reset) and starts a new interval.
+  ///
+  virtual void GetIntervalStats(IntervalStats stats[MAXOPTYPE]) = 0;
+  ///
+  /// Fills stats[op] with all operations reported since the last Reset.
+  ///
+  virtual void GetOpStats(OpStats stats[MAXOPTYPE]) = 0;
   virtual void Reset() = 0;
   virtual void SetWarmupTarget(int total_warmup_ops) = 0;
+  ///
+  /// Adds the engine counters of count operations of type op, each taken to
+  /// have done what the one measured did. Shared by all measurement types.
+  ///
+  void ReportCounters(Operation op, const EngineCounters &counters, uint64_t count);
+  ///
+  /// Adds count operations of type op that were measured but not timed,
+  /// the remainder of a sample period. They only count towards the totals
+  /// of GetOpStats.
+  ///
+  void ReportUnsampled(Operation op, uint64_t count);
+  ///
+  /// Called by a client thread once it is done reporting, so measurements
+  /// that keep state per thread can hand it on to the next thread.
+  ///
+  virtual void ReleaseThread() { }
+
+ protected:
+  Measurements();
+  // per operation averages of the engine counters, for the status message
+  std::string GetCounterMsg() const;
+  void FillCounters(OpStats stats[MAXOPTYPE]) const;
+  void ResetCounters();
+  void FillUnsampled(OpStats stats[MAXOPTYPE]) const;
+  void ResetUnsampled();
+
+ private:
+  struct alignas(64) CounterSums {
+    std::atomic<uint64_t> ops;
+    std::atomic<uint64_t> sum[MAXCOUNTER];
+  };
+  CounterSums counters_[MAXOPTYPE];
+  std::atomic<uint64_t> unsampled_[MAXOPTYPE];
 };
 
-class BasicMeasurements : public Measurements {
+class BasicMeasurements final : public Measurements {
  public:
   BasicMeasurements();
-  void Report(Operation op, uint64_t latency) override;
+  void Report(Operation op, uint64_t latency, uint64_t count) override;
   void ReportWarmup(Operation op) override;
   std::string GetStatusMsg() override;
+  void GetIntervalStats(IntervalStats stats[MAXOPTYPE]) override;
+  void GetOpStats(OpStats stats[MAXOPTYPE]) override;
   void Reset() override;
   void SetWarmupTarget(int total_warmup_ops) override;
  private:
   std::atomic<uint> count_[MAXOPTYPE];
   std::atomic<uint64_t> latency_sum_[MAXOPTYPE];
+  // for the standard deviation; squared nanoseconds overflow integers
+  std::atomic<double> latency_sq_sum_[MAXOPTYPE];
   std::atomic<uint64_t> latency_min_[MAXOPTYPE];
   std::atomic<uint64_t> latency_max_[MAXOPTYPE];
   std::atomic<uint> warmup_count_[MAXOPTYPE];
   std::atomic<int> total_warmup_ops_;
+  // totals seen by the previous GetIntervalStats call
+  uint64_t last_count_[MAXOPTYPE];
+  uint64_t last_latency_sum_[MAXOPTYPE];
 };
 
 #ifdef HDRMEASUREMENT
-class HdrHistogramMeasurements : public Measurements {
+class HdrHistogramMeasurements final : public Measurements {
  public:
   HdrHistogramMeasurements();
-  void Report(Operation op, uint64_t latency) override;
+  ~HdrHistogramMeasurements();
+  void Report(Operation op, uint64_t latency, uint64_t count) override;
   void ReportWarmup(Operation op) override;
   std::string GetStatusMsg() override;
+  void GetIntervalStats(IntervalStats stats[MAXOPTYPE]) override;
+  void GetOpStats(OpStats stats[MAXOPTYPE]) override;
   void Reset() override;
   void SetWarmupTarget(int total_warmup_ops) override;
  private:
+  // Clients record into interval recorders; Sample() swaps them out and
+  // folds the samples into both the cumulative and the interval histograms.
+  void Sample();
+
+  std::mutex mutex_;
+  hdr_interval_recorder recorder_[MAXOPTYPE];
   hdr_histogram *histogram_[MAXOPTYPE];
+  hdr_histogram *interval_[MAXOPTYPE];
   std::atomic<uint> warmup_count_[MAXOPTYPE];
   std::atomic<int> total_warmup_ops_;
 };
+
+// Each client thread records into interval recorders of its own, without
+// atomic read-modify-writes, and Sample() folds them into the shared
+// histograms when a status message is requested. A thread that is done
+// hands its shard on to the next new thread, so there are never more shards
+// than client threads running at once.
+class ShardedHdrHistogramMeasurements final : public Measurements {
+ public:
+  ShardedHdrHistogramMeasurements();
+  ~ShardedHdrHistogramMeasurements();
+  void Report(Operation op, uint64_t latency, uint64_t count) override;
+  void ReportWarmup(Operation op) override;
+  std::string GetStatusMsg() override;
+  void GetIntervalStats(IntervalStats stats[MAXOPTYPE]) override;
+  void GetOpStats(OpStats stats[MAXOPTYPE]) override;
+  void Reset() override;
+  void SetWarmupTarget(int total_warmup_ops) override;
+  void ReleaseThread() override;
+ private:
+  struct alignas(64) Shard {
+    hdr_interval_recorder recorder[MAXOPTYPE];
+    // written by the owning thread only, read by Sample()
+    std::atomic<uint64_t> warmup_count[MAXOPTYPE];
+  };
+  Shard *GetShard();
+  Shard *NewShard();
+  // folds the samples of all shards into histogram_ and interval_, returns
+  // the total warmup count
+  uint64_t Sample();
+
+  const uint64_t id_;
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  // shards of the threads that are done, for the next new thread
+  std::vector<Shard *> free_shards_;
+  hdr_histogram *histogram_[MAXOPTYPE];
+  hdr_histogram *interval_[MAXOPTYPE];
+  std::atomic<int> total_warmup_ops_;
+  // shard of the calling thread, keyed by instance id rather than address
+  // so a new instance never sees a stale shard
+  static thread_local uint64_t cached_id_;
+  static thread_local Shard *cached_shard_;
+};
 #endif
 
 Measurements *CreateMeasurements(utils::Properties *props);
 
+///
+/// Sampling of single operations: of every period[op] operations of type op
+/// one is timed, and reported for all of them. Set by measurement.sample_rate
+/// and, per operation type, measurement.sample_rate.<OP>, e.g.
+/// measurement.sample_rate.READ=0.01. A rate of 1 times every operation.
+///
+struct SamplePeriods {
+  uint32_t period[MAXOPTYPE];
+};
+
+SamplePeriods GetSamplePeriods(const utils::Properties &props);
+
 } // ycsbc
 
 #endif // YCSB_C_MEASUREMENTS
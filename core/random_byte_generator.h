@@ -9,27 +9,27 @@
 #define YCSB_C_RANDOM_BYTE_GENERATOR_H_
 
 #include "generator.h"
-#include "utils/utils.h"
-
-#include <random>
+#include "utils/random.h"
 
 namespace ycsbc {
 
 class RandomByteGenerator : public Generator<char> {
  public:
-  RandomByteGenerator() : off_(6) {}
+  // draws from rng, which must outlive the generator
+  explicit RandomByteGenerator(utils::Xoshiro256 &rng) : rng_(rng), off_(6) {}
 
   char Next();
   char Last();
 
  private:
+  utils::Xoshiro256 &rng_;
   char buf_[6];
   int off_;
 };
 
 inline char RandomByteGenerator::Next() {
   if (off_ == 6) {
-    int bytes = utils::ThreadLocalRandomInt();
+    uint32_t bytes = static_cast<uint32_t>(rng_.Next() >> 32);
     buf_[0] = static_cast<char>((bytes & 31) + ' ');
     buf_[1] = static_cast<char>(((bytes >> 5) & 63) + ' ');
     buf_[2] = static_cast<char>(((bytes >> 10) & 95)+ ' ');
@@ -2,25 +2,23 @@
 #define YCSB_C_RANDOM_COUNTER_GENERATOR_H_
 
 #include "generator.h"
-#include <vector>
-#include <random>
-#include <mutex>
+#include "utils/random.h"
 #include <atomic>
 
 namespace ycsbc {
 
+// Hands out start..start+count-1 once each, in a random order given by seed.
 class RandomCounterGenerator : public Generator<uint64_t> {
  public:
-  RandomCounterGenerator(uint64_t start, uint64_t count);
+  RandomCounterGenerator(uint64_t start, uint64_t count, uint64_t seed);
   uint64_t Next();
   uint64_t Last();
   
  private:
-  std::vector<uint64_t> keys_;
-  std::atomic<size_t> index_;
+  utils::RandomPermutation permutation_;
+  std::atomic<uint64_t> index_;
   uint64_t start_;
-  uint64_t last_returned_;
-  std::mutex mutex_;
+  std::atomic<uint64_t> last_returned_;
 };
 
 } // ycsbc
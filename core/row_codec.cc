@@ -0,0 +1,263 @@
+//
+//  row_codec.cc
+//  YCSB-cpp
+//
+
+#include "row_codec.h"
+
+#include <cstring>
+
+#include "core_workload.h"
+#include "utils/utils.h"
+
+namespace ycsbc {
+
+const std::string RowCodec::FORMAT_PROPERTY = "rowformat";
+const std::string RowCodec::FORMAT_DEFAULT = "fixed";
+
+namespace {
+  void EncodeFixed32(char *p, uint32_t v) {
+    std::memcpy(p, &v, sizeof(uint32_t));
+  }
+} // anonymous
+
+void RowCodec::Init(const utils::Properties &props) {
+  const std::string format = props.GetProperty(FORMAT_PROPERTY, FORMAT_DEFAULT);
+  if (format == "fixed") {
+    format_ = kFixedOffset;
+  } else if (format == "legacy") {
+    format_ = kLegacy;
+  } else {
+    throw utils::Exception("unknown row format: " + format);
+  }
+  field_prefix_ = props.GetProperty(CoreWorkload::FIELD_NAME_PREFIX,
+                                    CoreWorkload::FIELD_NAME_PREFIX_DEFAULT);
+  int field_count = std::stoi(props.GetProperty(CoreWorkload::FIELD_COUNT_PROPERTY,
+                                                CoreWorkload::FIELD_COUNT_DEFAULT));
+  field_names_.clear();
+  for (int i = 0; i < field_count; i++) {
+    field_names_.push_back(field_prefix_ + std::to_string(i));
+  }
+}
+
+uint32_t RowCodec::DecodeFixed32(const char *p) {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(uint32_t));
+  return v;
+}
+
+size_t RowCodec::FieldIndex(std::string_view name) const {
+  if (name.size() > field_prefix_.size() && name.compare(0, field_prefix_.size(), field_prefix_) == 0) {
+    size_t index = 0;
+    size_t i = field_prefix_.size();
+    for (; i < name.size() && name[i] >= '0' && name[i] <= '9'; i++) {
+      index = index * 10 + (name[i] - '0');
+    }
+    if (i == name.size() && index < field_names_.size()) {
+      return index;
+    }
+  }
+  throw utils::Exception("unknown field: " + std::string(name));
+}
+
+const char *RowCodec::FixedPayload(const char *p, size_t size, uint32_t *count) const {
+  if (size < sizeof(uint32_t)) {
+    throw utils::Exception("truncated row");
+  }
+  *count = DecodeFixed32(p);
+  if (*count != field_names_.size()) {
+    throw utils::Exception("row has " + std::to_string(*count) + " fields, fieldcount is " +
+                           std::to_string(field_names_.size()));
+  }
+  size_t header = sizeof(uint32_t) * (*count + 1);
+  if (size < header ||
+      (*count > 0 && size - header < (DecodeFixed32(p + header - sizeof(uint32_t)) & ~kAbsent))) {
+    throw utils::Exception("truncated row");
+  }
+  return p + header;
+}
+
+void RowCodec::Serialize(const std::vector<DB::Field> &values, std::string &data) const {
+  if (format_ == kLegacy) {
+    for (const DB::Field &field : values) {
+      uint32_t len = field.name.size();
+      data.append(reinterpret_cast<char *>(&len), sizeof(uint32_t));
+      data.append(field.name.data(), field.name.size());
+      len = field.value.size();
+      data.append(reinterpret_cast<char *>(&len), sizeof(uint32_t));
+      data.append(field.value.data(), field.value.size());
+    }
+    return;
+  }
+
+  const uint32_t count = field_names_.size();
+  const size_t header = data.size();
+  data.append(sizeof(uint32_t) * (count + 1), '\0');
+  EncodeFixed32(&data[header], count);
+  uint32_t end = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    // values usually come in index order, so slot i is tried at values[i] first
+    const DB::Field *field = nullptr;
+    if (i < values.size() && FieldIndex(values[i].name) == i) {
+      field = &values[i];
+    } else {
+      for (const DB::Field &f : values) {
+        if (FieldIndex(f.name) == i) {
+          field = &f;
+          break;
+        }
+      }
+    }
+    uint32_t slot = end | kAbsent;
+    if (field != nullptr) {
+      data.append(field->value);
+      end += field->value.size();
+      slot = end;
+    }
+    EncodeFixed32(&data[header + sizeof(uint32_t) * (i + 1)], slot);
+  }
+}
+
+template <typename F>
+void RowCodec::DeserializeLegacy(const char *p, size_t size, const std::vector<std::string> *fields,
+                                 F emit) const {
+  const char *lim = p + size;
+  std::vector<std::string>::const_iterator filter_iter;
+  if (fields != nullptr) {
+    filter_iter = fields->begin();
+  }
+  while (p != lim && (fields == nullptr || filter_iter != fields->end())) {
+    uint32_t len = DecodeFixed32(p);
+    p += sizeof(uint32_t);
+    std::string_view field(p, len);
+    p += len;
+    len = DecodeFixed32(p);
+    p += sizeof(uint32_t);
+    std::string_view value(p, len);
+    p += len;
+    if (fields == nullptr) {
+      emit(field, value);
+    } else if (*filter_iter == field) {
+      emit(field, value);
+      filter_iter++;
+    }
+  }
+}
+
+template <typename F>
+void RowCodec::DeserializeFixed(const char *p, size_t size, const std::vector<std::string> *fields,
+                                F emit) const {
+  uint32_t count;
+  const char *payload = FixedPayload(p, size, &count);
+  const char *ends = p + sizeof(uint32_t);
+  auto emit_index = [&](size_t i) {
+    uint32_t end = DecodeFixed32(ends + sizeof(uint32_t) * i);
+    if (end & kAbsent) {
+      return;
+    }
+    uint32_t start = i == 0 ? 0 : DecodeFixed32(ends + sizeof(uint32_t) * (i - 1)) & ~kAbsent;
+    emit(std::string_view(field_names_[i]), std::string_view(payload + start, end - start));
+  };
+  if (fields == nullptr) {
+    for (size_t i = 0; i < count; i++) {
+      emit_index(i);
+    }
+  } else {
+    for (const std::string &name : *fields) {
+      emit_index(FieldIndex(name));
+    }
+  }
+}
+
+void RowCodec::Deserialize(std::vector<DB::Field> &values, const char *p, size_t size,
+                           const std::vector<std::string> *fields) const {
+  auto emit = [&values](std::string_view name, std::string_view value) {
+    values.push_back({std::string(name), std::string(value)});
+  };
+  if (format_ == kLegacy) {
+    DeserializeLegacy(p, size, fields, emit);
+  } else {
+    DeserializeFixed(p, size, fields, emit);
+  }
+}
+
+void RowCodec::DeserializeView(std::vector<DB::FieldView> &values, const char *p, size_t size,
+                               const std::vector<std::string> *fields) const {
+  auto emit = [&values](std::string_view name, std::string_view value) {
+    values.push_back({name, value});
+  };
+  if (format_ == kLegacy) {
+    DeserializeLegacy(p, size, fields, emit);
+  } else {
+    DeserializeFixed(p, size, fields, emit);
+  }
+}
+
+void RowCodec::UpdateField(std::string &data, std::string_view name, std::string_view value) const {
+  if (format_ == kLegacy) {
+    size_t pos = 0;
+    while (pos < data.size()) {
+      uint32_t len = DecodeFixed32(&data[pos]);
+      std::string_view field(&data[pos + sizeof(uint32_t)], len);
+      pos += sizeof(uint32_t) + len;
+      len = DecodeFixed32(&data[pos]);
+      if (field == name) {
+        if (len == value.size()) {
+          std::memcpy(&data[pos + sizeof(uint32_t)], value.data(), value.size());
+        } else {
+          data.replace(pos + sizeof(uint32_t), len, value.data(), value.size());
+          EncodeFixed32(&data[pos], value.size());
+        }
+        return;
+      }
+      pos += sizeof(uint32_t) + len;
+    }
+    uint32_t len = name.size();
+    data.append(reinterpret_cast<char *>(&len), sizeof(uint32_t));
+    data.append(name.data(), name.size());
+    len = value.size();
+    data.append(reinterpret_cast<char *>(&len), sizeof(uint32_t));
+    data.append(value.data(), value.size());
+    return;
+  }
+
+  uint32_t count;
+  const size_t header = FixedPayload(data.data(), data.size(), &count) - data.data();
+  const size_t index = FieldIndex(name);
+  const size_t slot = sizeof(uint32_t) * (index + 1);
+  const uint32_t end_raw = DecodeFixed32(&data[slot]);
+  const uint32_t start = index == 0 ? 0 : DecodeFixed32(&data[slot - sizeof(uint32_t)]) & ~kAbsent;
+  const uint32_t len = (end_raw & ~kAbsent) - start;
+  if (!(end_raw & kAbsent) && len == value.size()) {
+    std::memcpy(&data[header + start], value.data(), value.size());
+    return;
+  }
+  data.replace(header + start, len, value.data(), value.size());
+  EncodeFixed32(&data[slot], start + value.size());
+  const uint32_t delta = static_cast<uint32_t>(value.size()) - len;
+  for (size_t i = index + 1; i < count; i++) {
+    const size_t s = sizeof(uint32_t) * (i + 1);
+    const uint32_t raw = DecodeFixed32(&data[s]);
+    // unsigned wrap-around makes this a subtraction when the value shrank
+    EncodeFixed32(&data[s], (raw & kAbsent) | (((raw & ~kAbsent) + delta) & ~kAbsent));
+  }
+}
+
+void RowCodec::Update(std::string &data, const std::vector<DB::Field> &values) const {
+  for (const DB::Field &field : values) {
+    UpdateField(data, field.name, field.value);
+  }
+}
+
+void RowCodec::Merge(std::string &data, const char *p, size_t size) const {
+  auto emit = [this, &data](std::string_view name, std::string_view value) {
+    UpdateField(data, name, value);
+  };
+  if (format_ == kLegacy) {
+    DeserializeLegacy(p, size, nullptr, emit);
+  } else {
+    DeserializeFixed(p, size, nullptr, emit);
+  }
+}
+
+} // ycsbc
@@ -0,0 +1,114 @@
+//
+//  row_codec.h
+//  YCSB-cpp
+//
+
+#ifndef YCSB_C_ROW_CODEC_H_
+#define YCSB_C_ROW_CODEC_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "db.h"
+#include "utils/properties.h"
+
+namespace ycsbc {
+
+///
+/// Encodes the fields of a record into the value stored by the bindings.
+///
+/// The default fixed-offset format stores only the values, in field index
+/// order, behind a header of end offsets:
+///
+///   uint32 field_count | uint32 end[field_count] | value bytes
+///
+/// so any single field is located in O(1) without touching the others.
+/// Field names are not stored; they are rebuilt from fieldnameprefix and the
+/// index. A field left out of Serialize is flagged absent, which lets a
+/// partial row (e.g. a merge operand) use the same encoding.
+///
+/// The legacy format is the length-prefixed name/value list the bindings
+/// used before, kept for reading old datasets.
+///
+class RowCodec {
+ public:
+  enum Format {
+    kFixedOffset,
+    kLegacy
+  };
+
+  ///
+  /// Reads the row format, field count and field name prefix.
+  ///
+  void Init(const utils::Properties &props);
+
+  Format format() const { return format_; }
+  size_t field_count() const { return field_names_.size(); }
+
+  ///
+  /// Appends the encoding of values to data. In the fixed-offset format
+  /// the fields may come in any order and any subset.
+  ///
+  void Serialize(const std::vector<DB::Field> &values, std::string &data) const;
+
+  ///
+  /// Appends the fields of an encoded row to values: the requested fields in
+  /// the requested order, or every present field if fields is NULL.
+  ///
+  void Deserialize(std::vector<DB::Field> &values, const char *p, size_t size,
+                   const std::vector<std::string> *fields) const;
+  void Deserialize(std::vector<DB::Field> &values, const std::string &data,
+                   const std::vector<std::string> *fields) const {
+    Deserialize(values, data.data(), data.size(), fields);
+  }
+
+  ///
+  /// Like Deserialize, but the values point into the encoded row and the
+  /// names into the row or the codec.
+  ///
+  void DeserializeView(std::vector<DB::FieldView> &values, const char *p, size_t size,
+                       const std::vector<std::string> *fields) const;
+
+  ///
+  /// Overwrites the given fields of an encoded row without decoding it.
+  /// A value of unchanged length is copied over the old bytes; otherwise the
+  /// row is spliced and the offsets behind it are shifted.
+  ///
+  void Update(std::string &data, const std::vector<DB::Field> &values) const;
+
+  ///
+  /// Applies the present fields of an encoded partial row onto data, as
+  /// Update does. Used to resolve merge operands.
+  ///
+  void Merge(std::string &data, const char *p, size_t size) const;
+
+  static const std::string FORMAT_PROPERTY;
+  static const std::string FORMAT_DEFAULT;
+
+ private:
+  // set in an end offset when the field is not part of the row
+  static const uint32_t kAbsent = 0x80000000u;
+
+  size_t FieldIndex(std::string_view name) const;
+  // header fields of a fixed-offset row, checked against the field count
+  const char *FixedPayload(const char *p, size_t size, uint32_t *count) const;
+  static uint32_t DecodeFixed32(const char *p);
+  void UpdateField(std::string &data, std::string_view name, std::string_view value) const;
+
+  template <typename F>
+  void DeserializeLegacy(const char *p, size_t size, const std::vector<std::string> *fields,
+                         F emit) const;
+  template <typename F>
+  void DeserializeFixed(const char *p, size_t size, const std::vector<std::string> *fields,
+                        F emit) const;
+
+  Format format_ = kFixedOffset;
+  std::string field_prefix_;
+  std::vector<std::string> field_names_;
+};
+
+} // ycsbc
+
+#endif // YCSB_C_ROW_CODEC_H_
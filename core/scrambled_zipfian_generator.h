@@ -32,8 +32,14 @@ class ScrambledZipfianGenerator : public Generator<uint64_t> {
   ScrambledZipfianGenerator(uint64_t num_items) :
       ScrambledZipfianGenerator(0, num_items - 1) { }
 
+  ScrambledZipfianGenerator(const ScrambledZipfianGenerator &other, uint64_t seed) :
+      base_(other.base_), num_items_(other.num_items_), generator_(other.generator_, seed) { }
+
   uint64_t Next();
   uint64_t Last();
+  ScrambledZipfianGenerator *Clone(uint64_t seed) const override {
+    return new ScrambledZipfianGenerator(*this, seed);
+  }
 
  private:
   static constexpr double kUsedZipfianConstant = 0.99;
@@ -11,7 +11,6 @@
 
 #include "generator.h"
 
-#include <atomic>
 #include <cstdint>
 #include "counter_generator.h"
 #include "zipfian_generator.h"
@@ -24,13 +23,20 @@ class SkewedLatestGenerator : public Generator<uint64_t> {
       basis_(counter), zipfian_(basis_.Last()) {
     Next();
   }
+
+  // the clone keeps following the shared counter
+  SkewedLatestGenerator(const SkewedLatestGenerator &other, uint64_t seed) :
+      basis_(other.basis_), zipfian_(other.zipfian_, seed), last_(other.last_) { }
   
   uint64_t Next();
   uint64_t Last() { return last_; }
+  SkewedLatestGenerator *Clone(uint64_t seed) const override {
+    return new SkewedLatestGenerator(*this, seed);
+  }
  private:
   CounterGenerator &basis_;
   ZipfianGenerator zipfian_;
-  std::atomic<uint64_t> last_;
+  uint64_t last_;
 };
 
 inline uint64_t SkewedLatestGenerator::Next() {
@@ -0,0 +1,222 @@
+//
+//  trace.cc
+//  YCSB-cpp
+//
+
+#include "trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <queue>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "utils/utils.h"
+
+namespace ycsbc {
+
+namespace {
+  const char kTraceMagic[] = "YCSBTRC1";
+  const size_t kTraceMagicSize = 8;
+  // timestamp, value_size, scan_length, key_size, op
+  const size_t kRecordHeaderSize = 8 + 4 + 4 + 2 + 1;
+
+  template <typename T>
+  void EncodeFixed(std::string &buf, T v) {
+    buf.append(reinterpret_cast<const char *>(&v), sizeof(T));
+  }
+
+  template <typename T>
+  T DecodeFixed(const char *p) {
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    return v;
+  }
+
+  // decodes the record at p and returns its encoded size
+  size_t DecodeRecord(const char *p, TraceRecord *record) {
+    record->timestamp = DecodeFixed<uint64_t>(p);
+    record->value_size = DecodeFixed<uint32_t>(p + 8);
+    record->scan_length = DecodeFixed<uint32_t>(p + 12);
+    uint16_t key_size = DecodeFixed<uint16_t>(p + 16);
+    record->op = static_cast<Operation>(static_cast<uint8_t>(p[18]));
+    record->key = std::string_view(p + kRecordHeaderSize, key_size);
+    return kRecordHeaderSize + key_size;
+  }
+
+  const char *MapFile(const std::string &path, size_t *size) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw utils::Exception("failed to open trace " + path + ": " + std::strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      throw utils::Exception("failed to stat trace " + path + ": " + std::strerror(errno));
+    }
+    *size = st.st_size;
+    if (*size == 0) {
+      close(fd);
+      return nullptr;
+    }
+    void *p = mmap(nullptr, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+      throw utils::Exception("failed to map trace " + path + ": " + std::strerror(errno));
+    }
+    // replay reads front to back; start reading ahead now
+    madvise(p, *size, MADV_SEQUENTIAL);
+    madvise(p, *size, MADV_WILLNEED);
+    return static_cast<const char *>(p);
+  }
+
+  void UnmapFile(const char *data, size_t size) {
+    if (data != nullptr) {
+      munmap(const_cast<char *>(data), size);
+    }
+  }
+
+  void WriteAll(std::FILE *f, const char *p, size_t size, const std::string &path) {
+    if (std::fwrite(p, 1, size, f) != size) {
+      throw utils::Exception("failed to write trace " + path + ": " + std::strerror(errno));
+    }
+  }
+} // anonymous
+
+void TraceWriter::Encode(std::string &buf, const TraceRecord &record) {
+  if (record.key.size() > UINT16_MAX) {
+    throw utils::Exception("key too long for a trace: " + std::string(record.key));
+  }
+  EncodeFixed<uint64_t>(buf, record.timestamp);
+  EncodeFixed<uint32_t>(buf, record.value_size);
+  EncodeFixed<uint32_t>(buf, record.scan_length);
+  EncodeFixed<uint16_t>(buf, record.key.size());
+  EncodeFixed<uint8_t>(buf, record.op);
+  buf.append(record.key.data(), record.key.size());
+}
+
+TraceWriter::TraceWriter(const std::string &path)
+    : path_(path), runs_path_(path + ".runs"), runs_size_(0), start_(Clock::now()) {
+  runs_ = std::fopen(runs_path_.c_str(), "wb");
+  if (runs_ == nullptr) {
+    throw utils::Exception("failed to create trace " + runs_path_ + ": " + std::strerror(errno));
+  }
+}
+
+TraceWriter::~TraceWriter() {
+  try {
+    Close();
+  } catch (const utils::Exception &e) {
+    std::cerr << "Caught exception: " << e.what() << std::endl;
+  }
+}
+
+void TraceWriter::AppendRun(const std::string &buf) {
+  if (buf.empty()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  WriteAll(runs_, buf.data(), buf.size(), runs_path_);
+  run_bounds_.emplace_back(runs_size_, runs_size_ + buf.size());
+  runs_size_ += buf.size();
+}
+
+void TraceWriter::Close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (runs_ == nullptr) {
+    return;
+  }
+  if (std::fclose(runs_) != 0) {
+    runs_ = nullptr;
+    throw utils::Exception("failed to write trace " + runs_path_ + ": " + std::strerror(errno));
+  }
+  runs_ = nullptr;
+
+  size_t size;
+  const char *data = MapFile(runs_path_, &size);
+  std::FILE *out = std::fopen(path_.c_str(), "wb");
+  if (out == nullptr) {
+    UnmapFile(data, size);
+    throw utils::Exception("failed to create trace " + path_ + ": " + std::strerror(errno));
+  }
+
+  // k-way merge of the runs, each of which is already in timestamp order
+  using Head = std::pair<uint64_t, size_t>;
+  std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+  std::vector<uint64_t> cursor(run_bounds_.size());
+  for (size_t i = 0; i < run_bounds_.size(); i++) {
+    cursor[i] = run_bounds_[i].first;
+    heads.emplace(DecodeFixed<uint64_t>(data + cursor[i]), i);
+  }
+  std::string buf(kTraceMagic, kTraceMagicSize);
+  try {
+    while (!heads.empty()) {
+      size_t run = heads.top().second;
+      heads.pop();
+      TraceRecord record;
+      size_t record_size = DecodeRecord(data + cursor[run], &record);
+      buf.append(data + cursor[run], record_size);
+      cursor[run] += record_size;
+      if (cursor[run] < run_bounds_[run].second) {
+        heads.emplace(DecodeFixed<uint64_t>(data + cursor[run]), run);
+      }
+      if (buf.size() >= (1 << 20)) {
+        WriteAll(out, buf.data(), buf.size(), path_);
+        buf.clear();
+      }
+    }
+    WriteAll(out, buf.data(), buf.size(), path_);
+  } catch (const utils::Exception &) {
+    std::fclose(out);
+    UnmapFile(data, size);
+    throw;
+  }
+  UnmapFile(data, size);
+  if (std::fclose(out) != 0) {
+    throw utils::Exception("failed to write trace " + path_ + ": " + std::strerror(errno));
+  }
+  unlink(runs_path_.c_str());
+}
+
+TraceReader::TraceReader(const std::string &path) : duration_(0), max_value_size_(0) {
+  data_ = MapFile(path, &size_);
+  if (size_ < kTraceMagicSize || std::memcmp(data_, kTraceMagic, kTraceMagicSize) != 0) {
+    UnmapFile(data_, size_);
+    throw utils::Exception("not a trace file: " + path);
+  }
+  size_t pos = kTraceMagicSize;
+  while (pos < size_) {
+    TraceRecord record;
+    if (size_ - pos < kRecordHeaderSize ||
+        size_ - pos < kRecordHeaderSize + DecodeFixed<uint16_t>(data_ + pos + 16)) {
+      UnmapFile(data_, size_);
+      throw utils::Exception("truncated trace: " + path);
+    }
+    offsets_.push_back(pos);
+    pos += DecodeRecord(data_ + pos, &record);
+    if (record.op >= MAXOPTYPE) {
+      UnmapFile(data_, size_);
+      throw utils::Exception("unknown operation in trace: " + path);
+    }
+    duration_ = std::max(duration_, record.timestamp);
+    max_value_size_ = std::max(max_value_size_, record.value_size);
+  }
+}
+
+TraceReader::~TraceReader() {
+  UnmapFile(data_, size_);
+}
+
+TraceRecord TraceReader::Get(size_t i) const {
+  TraceRecord record;
+  DecodeRecord(data_ + offsets_[i], &record);
+  return record;
+}
+
+} // ycsbc
@@ -0,0 +1,110 @@
+//
+//  trace.h
+//  YCSB-cpp
+//
+
+#ifndef YCSB_C_TRACE_H_
+#define YCSB_C_TRACE_H_
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "core_workload.h"
+
+namespace ycsbc {
+
+///
+/// One operation of a trace.
+///
+/// A trace file is the magic "YCSBTRC1" followed by records, each a fixed
+/// header and the key:
+///
+///   uint64 timestamp | uint32 value_size | uint32 scan_length | uint16 key_size | uint8 op | key
+///
+/// Timestamps are nanoseconds since the start of the trace and records are in
+/// timestamp order. value_size is the number of value bytes written, in total
+/// over all fields. Integers are native endian.
+///
+struct TraceRecord {
+  uint64_t timestamp;
+  Operation op;
+  std::string_view key;
+  uint32_t value_size;
+  uint32_t scan_length;
+};
+
+///
+/// Writes a trace from several threads. Each thread encodes its records into a
+/// buffer of its own and hands it over as a run; Close merges the runs into
+/// timestamp order.
+///
+class TraceWriter {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit TraceWriter(const std::string &path);
+  ~TraceWriter();
+
+  ///
+  /// Time the timestamps are relative to.
+  ///
+  Clock::time_point start() const { return start_; }
+
+  static void Encode(std::string &buf, const TraceRecord &record);
+
+  ///
+  /// Appends records encoded by Encode, in timestamp order, as one run.
+  ///
+  void AppendRun(const std::string &buf);
+
+  ///
+  /// Merges the runs into the trace file. Called by the destructor if needed.
+  ///
+  void Close();
+
+ private:
+  std::string path_;
+  std::string runs_path_;
+  std::FILE *runs_;
+  std::mutex mutex_;
+  std::vector<std::pair<uint64_t, uint64_t>> run_bounds_;
+  uint64_t runs_size_;
+  Clock::time_point start_;
+};
+
+///
+/// Read-only view of a trace file. The file is memory-mapped and read ahead,
+/// and an index of record offsets is built once so that any record is
+/// decoded in O(1) without copying.
+///
+class TraceReader {
+ public:
+  explicit TraceReader(const std::string &path);
+  ~TraceReader();
+
+  size_t size() const { return offsets_.size(); }
+  TraceRecord Get(size_t i) const;
+
+  ///
+  /// Timestamp of the last record; the length of the trace.
+  ///
+  uint64_t duration() const { return duration_; }
+  uint32_t max_value_size() const { return max_value_size_; }
+
+ private:
+  const char *data_;
+  size_t size_;
+  std::vector<uint64_t> offsets_;
+  uint64_t duration_;
+  uint32_t max_value_size_;
+};
+
+} // ycsbc
+
+#endif // YCSB_C_TRACE_H_
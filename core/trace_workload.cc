@@ -0,0 +1,139 @@
+//
+//  trace_workload.cc
+//  YCSB-cpp
+//
+
+#include "trace_workload.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "db_wrapper.h"
+#include "utils/utils.h"
+
+namespace ycsbc {
+
+const std::string TraceWorkload::FILE_PROPERTY = "trace.file";
+
+const std::string TraceWorkload::TIMING_PROPERTY = "trace.timing";
+const std::string TraceWorkload::TIMING_DEFAULT = "fast";
+
+const std::string TraceWorkload::SPEEDUP_PROPERTY = "trace.speedup";
+const std::string TraceWorkload::SPEEDUP_DEFAULT = "1.0";
+
+void TraceWorkload::Init(const utils::Properties &p) {
+  CoreWorkload::Init(p);
+
+  const std::string path = p.GetProperty(FILE_PROPERTY, "");
+  if (path.empty()) {
+    throw utils::Exception("trace.file is missing");
+  }
+  trace_.reset(new TraceReader(path));
+  if (trace_->size() == 0) {
+    throw utils::Exception("trace is empty: " + path);
+  }
+
+  const std::string timing = p.GetProperty(TIMING_PROPERTY, TIMING_DEFAULT);
+  if (timing == "fast") {
+    recorded_timing_ = false;
+  } else if (timing == "recorded") {
+    recorded_timing_ = true;
+  } else {
+    throw utils::Exception("unknown trace timing: " + timing);
+  }
+  speedup_ = std::stod(p.GetProperty(SPEEDUP_PROPERTY, SPEEDUP_DEFAULT));
+  if (speedup_ <= 0) {
+    throw utils::Exception("trace.speedup must be positive");
+  }
+
+  // traced values may be longer than the fieldlength the pool was sized for
+  const size_t pool_size = kValuePoolSize + trace_->max_value_size();
+  const size_t old_size = value_pool_.size();
+  value_pool_.resize(std::max(old_size, pool_size));
+  for (size_t i = old_size; i < value_pool_.size(); i++) {
+    value_pool_[i] = value_pool_[i - old_size];
+  }
+}
+
+TraceWorkload::Clock::time_point TraceWorkload::ReplayStart() {
+  int64_t start = start_.load(std::memory_order_acquire);
+  if (start == 0) {
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count();
+    start = start_.compare_exchange_strong(start, now, std::memory_order_acq_rel) ? now : start;
+  }
+  return Clock::time_point(std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(start)));
+}
+
+bool TraceWorkload::DoTransaction(DB &db) {
+  uint64_t n = next_record_.fetch_add(1, std::memory_order_relaxed);
+  TraceRecord record = trace_->Get(n % trace_->size());
+  if (recorded_timing_) {
+    // later passes over the trace follow on from the end of the previous one
+    uint64_t lap = n / trace_->size();
+    double offset = (lap * (trace_->duration() + 1) + record.timestamp) / speedup_;
+    Clock::time_point due = ReplayStart() + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double, std::nano>(offset));
+    std::this_thread::sleep_until(due);
+    // a record issued late is charged the time it was overdue, as in open-loop mode
+    DBWrapper::SetIntendedStartTime(due);
+  }
+  return Replay(db, record) == DB::kOK;
+}
+
+bool TraceWorkload::DoTransaction(DB &db, bool is_warmup) {
+  return DoTransaction(db);
+}
+
+bool TraceWorkload::DoTransactionBatch(DB &db, int n) {
+  bool ok = true;
+  for (int i = 0; i < n; i++) {
+    ok = DoTransaction(db) && ok;
+  }
+  return ok;
+}
+
+void TraceWorkload::BuildTraceValues(std::vector<DB::Field> &values, uint32_t value_size) {
+  // the traced size is spread over all fields, the remainder on the first ones
+  ThreadState &state = GetThreadState();
+  values.resize(field_count_);
+  for (int i = 0; i < field_count_; ++i) {
+    DB::Field &field = values[i];
+    field.name = field_names_[i];
+    FillValue(field.value, value_size / field_count_ + (i < int(value_size % field_count_) ? 1 : 0), state);
+  }
+}
+
+DB::Status TraceWorkload::Replay(DB &db, const TraceRecord &record) {
+  ThreadState &state = GetThreadState();
+  state.key.assign(record.key.data(), record.key.size());
+  switch (record.op) {
+    case READ:
+      return db.ReadView(table_name_, state.key, NextReadFields(state), state.view_result);
+    case READMODIFYWRITE:
+      state.result.clear();
+      db.Read(table_name_, state.key, NextReadFields(state), state.result);
+      [[fallthrough]];
+    case UPDATE:
+      if (write_all_fields()) {
+        BuildTraceValues(state.values, record.value_size);
+        return db.Update(table_name_, state.key, state.values);
+      }
+      state.single_value.resize(1);
+      state.single_value[0].name = NextFieldName();
+      FillValue(state.single_value[0].value, record.value_size, state);
+      return db.Update(table_name_, state.key, state.single_value);
+    case INSERT:
+      BuildTraceValues(state.values, record.value_size);
+      return db.Insert(table_name_, state.key, state.values);
+    case SCAN:
+      return db.ScanVisit(table_name_, state.key, record.scan_length, NextReadFields(state),
+                          [](const std::vector<DB::FieldView> &) { return true; });
+    case DELETE:
+      return db.Delete(table_name_, state.key);
+    default:
+      throw utils::Exception("Operation request is not recognized!");
+  }
+}
+
+} // ycsbc
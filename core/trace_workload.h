@@ -0,0 +1,72 @@
+//
+//  trace_workload.h
+//  YCSB-cpp
+//
+
+#ifndef YCSB_C_TRACE_WORKLOAD_H_
+#define YCSB_C_TRACE_WORKLOAD_H_
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "core_workload.h"
+#include "trace.h"
+
+namespace ycsbc {
+
+///
+/// Replays a trace (see TraceRecord) instead of drawing operations from the
+/// CoreWorkload distributions. Client threads take the records in trace
+/// order from a shared cursor; keys and value sizes come from the trace, the
+/// value bytes and the fields read come from the CoreWorkload settings. A
+/// trace shorter than operationcount starts over. The load phase is the
+/// CoreWorkload one.
+///
+class TraceWorkload : public CoreWorkload {
+ public:
+  ///
+  /// The name of the property for the trace file to replay.
+  ///
+  static const std::string FILE_PROPERTY;
+
+  ///
+  /// The name of the property for the replay timing. "fast" issues every
+  /// record as soon as a thread is free, "recorded" issues it at its recorded
+  /// time and measures latency from that time.
+  ///
+  static const std::string TIMING_PROPERTY;
+  static const std::string TIMING_DEFAULT;
+
+  ///
+  /// The name of the property for the factor recorded timestamps are
+  /// divided by.
+  ///
+  static const std::string SPEEDUP_PROPERTY;
+  static const std::string SPEEDUP_DEFAULT;
+
+  void Init(const utils::Properties &p) override;
+
+  bool DoTransaction(DB &db) override;
+  bool DoTransaction(DB &db, bool is_warmup) override;
+  bool DoTransactionBatch(DB &db, int n) override;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  Clock::time_point ReplayStart();
+  DB::Status Replay(DB &db, const TraceRecord &record);
+  void BuildTraceValues(std::vector<DB::Field> &values, uint32_t value_size);
+
+  std::unique_ptr<TraceReader> trace_;
+  bool recorded_timing_ = false;
+  double speedup_ = 1.0;
+  std::atomic<uint64_t> next_record_{0};
+  // nanoseconds since the clock epoch, 0 until the first record is replayed
+  std::atomic<int64_t> start_{0};
+};
+
+} // ycsbc
+
+#endif // YCSB_C_TRACE_WORKLOAD_H_
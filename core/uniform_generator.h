@@ -10,28 +10,31 @@
 #define YCSB_C_UNIFORM_GENERATOR_H_
 
 #include "generator.h"
-
-#include <atomic>
-#include <random>
+#include "utils/random.h"
 
 namespace ycsbc {
 
 class UniformGenerator : public Generator<uint64_t> {
  public:
   // Both min and max are inclusive
-  UniformGenerator(uint64_t min, uint64_t max) : dist_(min, max) { Next(); }
+  UniformGenerator(uint64_t min, uint64_t max, uint64_t seed = utils::RandomSeed())
+      : min_(min), range_(max - min + 1), rng_(seed) { Next(); }
 
   uint64_t Next();
   uint64_t Last();
+  UniformGenerator *Clone(uint64_t seed) const override {
+    return new UniformGenerator(min_, min_ + range_ - 1, seed);
+  }
 
  private:
-  std::mt19937_64 generator_;
-  std::uniform_int_distribution<uint64_t> dist_;
+  uint64_t min_;
+  uint64_t range_;
+  utils::Xoshiro256 rng_;
   uint64_t last_int_;
 };
 
 inline uint64_t UniformGenerator::Next() {
-  return last_int_ = dist_(generator_);
+  return last_int_ = min_ + rng_.Uniform(range_);
 }
 
 inline uint64_t UniformGenerator::Last() {
@@ -6,22 +6,29 @@
 //  Copyright (c) 2014 Jinglei Ren <jinglei@ren.systems>.
 //
 
+#include <algorithm>
 #include <cstring>
 #include <ctime>
 #include <atomic>
 
 #include <string>
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <vector>
 #include <thread>
 #include <future>
 #include <chrono>
 #include <iomanip>
+#include <memory>
 
 #include "client.h"
 #include "core_workload.h"
 #include "db_factory.h"
 #include "measurements.h"
+#include "trace.h"
+#include "trace_workload.h"
+#include "utils/affinity.h"
 #include "utils/countdown_latch.h"
 #include "utils/rate_limit.h"
 #include "utils/timer.h"
@@ -31,46 +38,249 @@ void UsageMessage(const char *command);
 bool StrStartWith(const char *str, const char *pre);
 void ParseCommandLine(int argc, const char *argv[], ycsbc::utils::Properties &props);
 
-void StatusThread(ycsbc::Measurements *measurements, ycsbc::utils::CountDownLatch *latch, int interval) {
+std::string JsonString(const std::string &str) {
+  std::ostringstream out;
+  out << '"';
+  for (unsigned char c : str) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (c < 0x20) {
+      out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+  return out.str();
+}
+
+// Operations per second for the JSON outputs, 0 over an empty time span so
+// that no nan or inf ends up in the document
+double Rate(uint64_t count, double seconds) {
+  return seconds > 0 ? count / seconds : 0;
+}
+
+void WriteTimeSeries(std::ostream &os, const std::string &phase, double timestamp, double elapsed,
+                     double interval, const ycsbc::IntervalStats stats[ycsbc::MAXOPTYPE],
+                     const ycsbc::EngineStats &engine_stats) {
+  std::ostringstream line;
+  line << std::fixed << std::setprecision(3)
+       << "{\"phase\":" << JsonString(phase) << ",\"timestamp\":" << timestamp
+       << ",\"time\":" << elapsed << ",\"interval\":" << interval;
+
+  uint64_t total_cnt = 0;
+  std::ostringstream ops;
+  ops << std::fixed << std::setprecision(3);
+  bool first = true;
+  for (int i = 0; i < ycsbc::MAXOPTYPE; i++) {
+    ycsbc::Operation op = static_cast<ycsbc::Operation>(i);
+    const ycsbc::IntervalStats &st = stats[op];
+    if (st.count == 0) {
+      continue;
+    }
+    if (!ycsbc::IsBatchOperation(op)) {
+      total_cnt += st.count;
+    }
+    ops << (first ? "" : ",") << "\"" << ycsbc::kOperationString[op] << "\":{"
+        << "\"count\":" << st.count
+        << ",\"ops_per_sec\":" << Rate(st.count, interval)
+        << ",\"avg_us\":" << st.avg / 1000.0;
+    if (st.has_percentiles) {
+      ops << ",\"min_us\":" << st.min / 1000.0
+          << ",\"max_us\":" << st.max / 1000.0
+          << ",\"p50_us\":" << st.p50 / 1000.0
+          << ",\"p90_us\":" << st.p90 / 1000.0
+          << ",\"p99_us\":" << st.p99 / 1000.0
+          << ",\"p99.9_us\":" << st.p999 / 1000.0;
+    }
+    ops << "}";
+    first = false;
+  }
+  line << ",\"ops_per_sec\":" << Rate(total_cnt, interval)
+       << ",\"ops\":{" << ops.str() << "}";
+  if (!engine_stats.empty()) {
+    line << ",\"engine\":{";
+    for (size_t i = 0; i < engine_stats.size(); i++) {
+      line << (i == 0 ? "" : ",") << "\"" << engine_stats[i].first << "\":" << engine_stats[i].second;
+    }
+    line << "}";
+  }
+  line << "}\n";
+  os << line.str() << std::flush;
+}
+
+// Totals of a phase for the final report
+struct PhaseReport {
+  std::string name;
+  // runtime and operations exclude the warmup, total_runtime includes it
+  double runtime;
+  double total_runtime;
+  uint64_t warmup_operations;
+  uint64_t operations;
+  ycsbc::OpStats stats[ycsbc::MAXOPTYPE];
+};
+
+// Final report as one JSON document: the properties the run was configured
+// with and, per phase, the totals and the latency distribution of every
+// operation type. Latencies are in microseconds except in "histogram", the
+// base64 HdrHistogram of nanosecond latencies, which tools can decode and
+// merge across runs, and "engine", the engine counters if the DB collected
+// them.
+void WriteReport(std::ostream &os, const ycsbc::utils::Properties &props,
+                 const std::vector<PhaseReport> &phases) {
+  os << std::fixed << std::setprecision(3) << "{\"config\":{";
+  bool first = true;
+  for (const auto &prop : props.properties()) {
+    os << (first ? "" : ",") << JsonString(prop.first) << ":" << JsonString(prop.second);
+    first = false;
+  }
+  os << "},\"phases\":{";
+  for (size_t i = 0; i < phases.size(); i++) {
+    const PhaseReport &phase = phases[i];
+    os << (i == 0 ? "" : ",") << JsonString(phase.name) << ":{"
+       << "\"runtime_sec\":" << phase.runtime
+       << ",\"total_runtime_sec\":" << phase.total_runtime
+       << ",\"warmup_operations\":" << phase.warmup_operations
+       << ",\"operations\":" << phase.operations
+       << ",\"ops_per_sec\":" << Rate(phase.operations, phase.runtime)
+       << ",\"ops\":{";
+    first = true;
+    for (int j = 0; j < ycsbc::MAXOPTYPE; j++) {
+      ycsbc::Operation op = static_cast<ycsbc::Operation>(j);
+      const ycsbc::OpStats &st = phase.stats[op];
+      if (st.count == 0) {
+        continue;
+      }
+      os << (first ? "" : ",") << "\"" << ycsbc::kOperationString[op] << "\":{"
+         << "\"count\":" << st.count;
+      // operations that were only counted have no latencies to report
+      if (st.timed_count > 0) {
+        os << ",\"min_us\":" << st.min / 1000.0
+           << ",\"max_us\":" << st.max / 1000.0
+           << ",\"mean_us\":" << st.mean / 1000.0
+           << ",\"stddev_us\":" << st.stddev / 1000.0;
+      }
+      if (!st.percentiles.empty()) {
+        // [percentile, latency] pairs; percentiles need more digits near 100
+        os << ",\"percentiles\":[";
+        for (size_t k = 0; k < st.percentiles.size(); k++) {
+          os << (k == 0 ? "" : ",") << "[" << std::defaultfloat << std::setprecision(12)
+             << st.percentiles[k].first << std::fixed << std::setprecision(3) << ","
+             << st.percentiles[k].second / 1000.0 << "]";
+        }
+        os << "]";
+      }
+      if (!st.histogram.empty()) {
+        os << ",\"histogram\":\"" << st.histogram << "\"";
+      }
+      if (st.counter_ops > 0) {
+        // engine counter totals over the operations that reported them
+        os << ",\"engine\":{\"ops\":" << st.counter_ops;
+        for (int k = 0; k < ycsbc::MAXCOUNTER; k++) {
+          os << ",\"" << ycsbc::kEngineCounterString[k] << "\":" << st.counters[k];
+        }
+        os << "}";
+      }
+      os << "}";
+      first = false;
+    }
+    os << "}}";
+  }
+  os << "}}\n" << std::flush;
+}
+
+// Prints the status line and appends the time series every interval until
+// the latch is released. With an engine, its statistics are sampled on the
+// same ticks and added to both.
+void StatusThread(ycsbc::Measurements *measurements, ycsbc::DB *engine, ycsbc::utils::CountDownLatch *latch,
+                  double interval, bool show_status, std::ostream *timeseries, std::string phase) {
   using namespace std::chrono;
   time_point<system_clock> start = system_clock::now();
+  time_point<steady_clock> phase_start = steady_clock::now();
+  time_point<steady_clock> last_tick = phase_start;
+  ycsbc::IntervalStats stats[ycsbc::MAXOPTYPE];
+  ycsbc::EngineStats engine_stats;
+  if (engine != nullptr) {
+    engine->SampleEngineStats(engine_stats);
+  }
   bool done = false;
   while (1) {
-    time_point<system_clock> now = system_clock::now();
-    std::time_t now_c = system_clock::to_time_t(now);
-    duration<double> elapsed_time = now - start;
-
-    std::cout << std::put_time(std::localtime(&now_c), "%F %T") << ' '
-              << static_cast<long long>(elapsed_time.count()) << " sec: ";
-
-    std::cout << measurements->GetStatusMsg() << std::endl;
+    if (show_status) {
+      time_point<system_clock> now = system_clock::now();
+      std::time_t now_c = system_clock::to_time_t(now);
+      duration<double> elapsed_time = now - start;
+
+      std::cout << std::put_time(std::localtime(&now_c), "%F %T") << ' '
+                << static_cast<long long>(elapsed_time.count()) << " sec: ";
+
+      std::cout << measurements->GetStatusMsg();
+      if (!engine_stats.empty()) {
+        std::cout << "\n[ENGINE:";
+        for (const auto &stat : engine_stats) {
+          std::cout << " " << stat.first << "=" << stat.second;
+        }
+        std::cout << "]";
+      }
+      std::cout << std::endl;
+    }
 
     if (done) {
       break;
     }
     done = latch->AwaitFor(interval);
+
+    if (engine != nullptr) {
+      engine_stats.clear();
+      engine->SampleEngineStats(engine_stats);
+    }
+    if (timeseries != nullptr) {
+      // rates use the measured tick length, the latch wait may return early or late
+      time_point<steady_clock> tick = steady_clock::now();
+      measurements->GetIntervalStats(stats);
+      duration<double> tick_interval = tick - last_tick;
+      duration<double> elapsed_time = tick - phase_start;
+      duration<double> timestamp = system_clock::now().time_since_epoch();
+      WriteTimeSeries(*timeseries, phase, timestamp.count(), elapsed_time.count(),
+                      tick_interval.count(), stats, engine_stats);
+      last_tick = tick;
+    }
   };
 }
 
+// Share of thread i in an aggregate rate; the remainder goes to the first
+// threads so the shares add up to the target, and a positive target never
+// leaves a thread unlimited
+int64_t ThreadRate(int64_t rate, int64_t num_threads, int64_t i) {
+  if (rate <= 0) {
+    return rate;
+  }
+  return std::max<int64_t>(1, rate / num_threads + (i < rate % num_threads ? 1 : 0));
+}
+
+void SetRates(const std::vector<ycsbc::utils::RateLimiter *> &rate_limiters, int64_t rate) {
+  int64_t num_threads = rate_limiters.size();
+  for (int64_t i = 0; i < num_threads; i++) {
+    rate_limiters[i]->SetRate(ThreadRate(rate, num_threads, i));
+  }
+}
+
 void RateLimitThread(std::string rate_file, std::vector<ycsbc::utils::RateLimiter *> rate_limiters,
                      ycsbc::utils::CountDownLatch *latch) {
   std::ifstream ifs;
   ifs.open(rate_file);
 
   if (!ifs.is_open()) {
-    ycsbc::utils::Exception("failed to open: " + rate_file);
+    std::cerr << "Failed to open rate file " << rate_file << std::endl;
+    exit(1);
   }
 
-  int64_t num_threads = rate_limiters.size();
-
   int64_t last_time = 0;
-  while (!ifs.eof()) {
-    int64_t next_time;
-    int64_t next_rate;
-    ifs >> next_time >> next_rate;
-
+  int64_t next_time;
+  int64_t next_rate;
+  while (ifs >> next_time >> next_rate) {
     if (next_time <= last_time) {
-      ycsbc::utils::Exception("invalid rate file");
+      std::cerr << "Invalid rate file " << rate_file << std::endl;
+      exit(1);
     }
 
     bool done = latch->AwaitFor(next_time - last_time);
@@ -79,178 +289,516 @@ void RateLimitThread(std::string rate_file, std::vector<ycsbc::utils::RateLimite
     }
     last_time = next_time;
 
-    for (auto x : rate_limiters) {
-      x->SetRate(next_rate / num_threads);
-    }
+    SetRates(rate_limiters, next_rate);
   }
 }
 
-int main(const int argc, const char *argv[]) {
-  ycsbc::utils::Properties props;
-  ParseCommandLine(argc, argv, props);
-
-  const bool do_load = (props.GetProperty("doload", "false") == "true");
-  const bool do_transaction = (props.GetProperty("dotransaction", "false") == "true");
-  if (!do_load && !do_transaction) {
-    std::cerr << "No operation to do" << std::endl;
-    exit(1);
-  }
-
-  const int num_threads = stoi(props.GetProperty("threadcount", "1"));
-
-  ycsbc::Measurements *measurements = ycsbc::CreateMeasurements(&props);
-  if (measurements == nullptr) {
-    std::cerr << "Unknown measurements name" << std::endl;
-    exit(1);
+void RateCurveThread(ycsbc::utils::RateCurve curve, std::vector<ycsbc::utils::RateLimiter *> rate_limiters,
+                     ycsbc::utils::CountDownLatch *latch) {
+  using namespace std::chrono;
+  // fine enough that a ramp or sine looks continuous to the limiters
+  const double tick = 0.01;
+  const time_point<steady_clock> start = steady_clock::now();
+  while (!latch->AwaitFor(tick)) {
+    duration<double> elapsed = steady_clock::now() - start;
+    SetRates(rate_limiters, curve.RateAt(elapsed.count()));
   }
+}
 
-  ycsbc::CoreWorkload wl;
-  wl.Init(props);
-
-  // Calculate warmup operations for transaction phase
-  int warmup_ops = 0;
-  if (do_transaction) {
-    const int total_ops = stoi(props[ycsbc::CoreWorkload::OPERATION_COUNT_PROPERTY]);
-    warmup_ops = static_cast<int>(total_ops * wl.warmup_ratio());
+// What all phases share: where measurements go and how progress is shown
+struct PhaseEnv {
+  ycsbc::Measurements *measurements;
+  bool show_status;
+  double status_interval;
+  std::ostream *timeseries;
+  // sample engine statistics on the status ticks
+  bool engine_stats;
+};
+
+std::unique_ptr<ycsbc::CoreWorkload> CreateWorkload(const ycsbc::utils::Properties &props) {
+  // workload=trace replays trace.file, anything else is the synthetic CoreWorkload
+  std::unique_ptr<ycsbc::CoreWorkload> workload;
+  if (props.GetProperty("workload", "") == "trace") {
+    workload.reset(new ycsbc::TraceWorkload);
+  } else {
+    workload.reset(new ycsbc::CoreWorkload);
   }
+  workload->Init(props);
+  return workload;
+}
 
+std::vector<ycsbc::DB *> CreateDBs(ycsbc::utils::Properties *props, ycsbc::Measurements *measurements,
+                                   int num_threads, const std::atomic<bool> *measuring,
+                                   ycsbc::TraceWriter *trace) {
   std::vector<ycsbc::DB *> dbs;
   for (int i = 0; i < num_threads; i++) {
-    ycsbc::DB *db = ycsbc::DBFactory::CreateDB(&props, measurements, warmup_ops);
+    ycsbc::DB *db = ycsbc::DBFactory::CreateDB(props, measurements, measuring, trace);
     if (db == nullptr) {
-      std::cerr << "Unknown database name " << props["dbname"] << std::endl;
+      std::cerr << "Unknown database name " << props->GetProperty("dbname") << std::endl;
       exit(1);
     }
     dbs.push_back(db);
   }
+  return dbs;
+}
 
-  // Set warmup target for measurements
-  if (warmup_ops > 0) {
-    measurements->SetWarmupTarget(warmup_ops);
+// Loads total_ops records with one client thread per db, the threads
+// numbered from first_thread_id. Prints the totals and returns them for the
+// report.
+PhaseReport RunLoadPhase(const PhaseEnv &env, const std::string &name, ycsbc::CoreWorkload &wl,
+                         const std::vector<ycsbc::DB *> &dbs, const ycsbc::utils::ThreadPlacement &placement,
+                         int total_ops, bool bulkload, bool init_db, bool cleanup_db, int first_thread_id) {
+  const int num_threads = dbs.size();
+  const bool run_status = env.show_status || env.timeseries != nullptr;
+
+  ycsbc::utils::CountDownLatch latch(num_threads);
+  ycsbc::utils::Timer<double> timer;
+
+  timer.Start();
+  std::future<void> status_future;
+  if (run_status) {
+    status_future = std::async(std::launch::async, StatusThread, env.measurements,
+                               env.engine_stats ? dbs[0] : nullptr, &latch, env.status_interval,
+                               env.show_status, env.timeseries, name);
   }
+  std::vector<std::future<int>> client_threads;
+  uint64_t first_key_num = wl.insert_start();
+  for (int i = 0; i < num_threads; ++i) {
+    int thread_ops = total_ops / num_threads;
+    if (i < total_ops % num_threads) {
+      thread_ops++;
+    }
+    const int thread_id = first_thread_id + i;
+
+    if (bulkload) {
+      // each thread bulk loads a disjoint range of key numbers
+      client_threads.emplace_back(std::async(std::launch::async, [&, db = dbs[i], i, thread_id, first_key_num, thread_ops] {
+        ycsbc::PlaceThread(placement, i);
+        return ycsbc::BulkLoadThread(db, &wl, thread_id, first_key_num, thread_ops, init_db, cleanup_db, &latch);
+      }));
+      first_key_num += thread_ops;
+    } else {
+      client_threads.emplace_back(std::async(std::launch::async, [&, db = dbs[i], i, thread_id, thread_ops] {
+        ycsbc::PlaceThread(placement, i);
+        return ycsbc::ClientThread(db, &wl, thread_id, thread_ops, true, init_db, cleanup_db, &latch, nullptr);
+      }));
+    }
+  }
+  assert((int)client_threads.size() == num_threads);
 
-  // print status periodically
-  const bool show_status = (props.GetProperty("status", "false") == "true");
-  const int status_interval = std::stoi(props.GetProperty("status.interval", "10"));
+  int sum = 0;
+  for (auto &n : client_threads) {
+    assert(n.valid());
+    sum += n.get();
+  }
+  double runtime = timer.End();
 
-  // load phase
-  if (do_load) {
-    const int total_ops = stoi(props[ycsbc::CoreWorkload::RECORD_COUNT_PROPERTY]);
+  if (run_status) {
+    status_future.wait();
+  }
 
-    ycsbc::utils::CountDownLatch latch(num_threads);
-    ycsbc::utils::Timer<double> timer;
+  std::cout << "Load runtime(sec): " << runtime << std::endl;
+  std::cout << "Load operations(ops): " << sum << std::endl;
+  std::cout << "Load throughput(ops/sec): " << sum / runtime << std::endl;
+
+  PhaseReport report;
+  report.name = name;
+  report.runtime = runtime;
+  report.total_runtime = runtime;
+  report.warmup_operations = 0;
+  report.operations = sum;
+  env.measurements->GetOpStats(report.stats);
+  return report;
+}
 
-    timer.Start();
-    std::future<void> status_future;
-    if (show_status) {
-      status_future = std::async(std::launch::async, StatusThread,
-                                 measurements, &latch, status_interval);
-    }
-    std::vector<std::future<int>> client_threads;
-    for (int i = 0; i < num_threads; ++i) {
-      int thread_ops = total_ops / num_threads;
-      if (i < total_ops % num_threads) {
-        thread_ops++;
-      }
+// Runs up to total_ops transactions with one client thread per db, the
+// threads numbered from first_thread_id. The dbs were created with the
+// measuring flag, which is clear during warmup. Warmup, rate limits and the
+// time limit come from props. Prints the totals and returns them for the
+// report.
+PhaseReport RunTransactionPhase(const PhaseEnv &env, const std::string &name,
+                                const ycsbc::utils::Properties &props, ycsbc::CoreWorkload &wl,
+                                const std::vector<ycsbc::DB *> &dbs, std::atomic<bool> *measuring,
+                                const ycsbc::utils::ThreadPlacement &placement, int total_ops,
+                                bool init_db, bool cleanup_db, int first_thread_id) {
+  const int num_threads = dbs.size();
+  const bool run_status = env.show_status || env.timeseries != nullptr;
+
+  // initial ops per second, unlimited if <= 0
+  const int64_t ops_limit = std::stoi(props.GetProperty("limit.ops", "0"));
+  // rate file path for dynamic rate limiting, format "time_stamp_sec new_ops_per_second" per line
+  std::string rate_file = props.GetProperty("limit.file", "");
+  // open-loop mode, latency is measured from the scheduled start of each operation
+  const bool open_loop = ycsbc::utils::StrToBool(props.GetProperty("limit.openloop", "false"));
+  // rate as a function of time, e.g. "ramp:10000:100000:60", see utils::RateCurve
+  const std::string rate_curve = props.GetProperty("limit.curve", "");
+  if (rate_curve != "" && rate_file != "") {
+    std::cerr << "limit.file and limit.curve cannot be combined" << std::endl;
+    exit(1);
+  }
+  std::unique_ptr<ycsbc::utils::RateCurve> curve;
+  if (rate_curve != "") {
+    curve.reset(new ycsbc::utils::RateCurve(rate_curve));
+  }
+  const int64_t initial_rate = curve ? curve->RateAt(0) : ops_limit;
+  // seconds after which the phase stops even if operations are left, 0 for no limit
+  const double max_execution_time = std::stod(props.GetProperty("maxexecutiontime", "0"));
+  // warmup by time instead of by warmup_ratio: measurement starts this many
+  // seconds into the phase
+  const double warmup_seconds = std::stod(props.GetProperty("warmup.seconds", "0"));
+  if (warmup_seconds > 0 && wl.warmup_ratio() > 0) {
+    std::cerr << "warmup.seconds and warmup_ratio cannot be combined" << std::endl;
+    exit(1);
+  }
+  if (warmup_seconds > 0 && max_execution_time > 0 && warmup_seconds >= max_execution_time) {
+    std::cerr << "warmup.seconds must be less than maxexecutiontime" << std::endl;
+    exit(1);
+  }
+  const int warmup_ops = static_cast<int>(total_ops * wl.warmup_ratio());
+  env.measurements->SetWarmupTarget(warmup_ops);
+
+  ycsbc::utils::CountDownLatch latch(num_threads);
+  ycsbc::utils::Timer<double> timer;
+
+  timer.Start();
+  std::future<void> status_future;
+  if (run_status) {
+    status_future = std::async(std::launch::async, StatusThread, env.measurements,
+                               env.engine_stats ? dbs[0] : nullptr, &latch, env.status_interval,
+                               env.show_status, env.timeseries, name);
+  }
 
-      client_threads.emplace_back(std::async(std::launch::async, ycsbc::ClientThread, dbs[i], &wl,
-                                             thread_ops, true, true, !do_transaction, &latch, nullptr));
+  // with warmup_ratio the threads start the measurement once all of them are
+  // through their share of the warmup, with warmup.seconds this thread does
+  ycsbc::MeasurementEpoch epoch(measuring, warmup_ops > 0 ? num_threads : 0);
+  if (warmup_ops == 0 && warmup_seconds <= 0) {
+    epoch.Start();
+  }
+  std::atomic<bool> stop(false);
+
+  std::vector<std::future<int>> client_threads;
+  std::vector<ycsbc::utils::RateLimiter *> rate_limiters;
+  for (int i = 0; i < num_threads; ++i) {
+    int thread_ops = total_ops / num_threads;
+    if (i < total_ops % num_threads) {
+      thread_ops++;
     }
-    assert((int)client_threads.size() == num_threads);
-
-    int sum = 0;
-    for (auto &n : client_threads) {
-      assert(n.valid());
-      sum += n.get();
+    ycsbc::utils::RateLimiter *rlim = nullptr;
+    if (initial_rate > 0 || rate_file != "") {
+      int64_t per_thread_ops = ThreadRate(initial_rate, num_threads, i);
+      rlim = new ycsbc::utils::RateLimiter(per_thread_ops, per_thread_ops, open_loop);
     }
-    double runtime = timer.End();
+    rate_limiters.push_back(rlim);
+    const int thread_warmup = warmup_ops / num_threads + (i < warmup_ops % num_threads ? 1 : 0);
+    const int thread_id = first_thread_id + i;
+    client_threads.emplace_back(std::async(std::launch::async, [&, db = dbs[i], i, thread_id, thread_ops, thread_warmup, rlim] {
+      ycsbc::PlaceThread(placement, i);
+      return ycsbc::ClientThreadWithWarmup(db, &wl, thread_id, thread_ops, false, init_db, cleanup_db, &latch,
+                                           &epoch, thread_warmup, rlim, &stop);
+    }));
+  }
 
-    if (show_status) {
-      status_future.wait();
+  std::future<void> rlim_future;
+  if (rate_file != "") {
+    rlim_future = std::async(std::launch::async, RateLimitThread, rate_file, rate_limiters, &latch);
+  } else if (curve) {
+    rlim_future = std::async(std::launch::async, RateCurveThread, *curve, rate_limiters, &latch);
+  }
+
+  assert((int)client_threads.size() == num_threads);
+
+  // the time limit also bounds the warmup
+  const double warmup_wait = max_execution_time > 0 ? std::min(warmup_seconds, max_execution_time)
+                                                    : warmup_seconds;
+  if (warmup_seconds > 0 && !latch.AwaitFor(warmup_wait)) {
+    epoch.Start();
+  }
+  if (max_execution_time > 0 && !latch.AwaitFor(max_execution_time - timer.End())) {
+    stop.store(true, std::memory_order_relaxed);
+  }
+
+  int sum = 0;
+  for (auto &n : client_threads) {
+    assert(n.valid());
+    sum += n.get();
+  }
+  double total_runtime = timer.End();
+  double measurement_runtime = epoch.Elapsed();
+
+  if (run_status) {
+    status_future.wait();
+  }
+  if (rlim_future.valid()) {
+    rlim_future.wait();
+  }
+  for (ycsbc::utils::RateLimiter *rlim : rate_limiters) {
+    delete rlim;
+  }
+
+  PhaseReport report;
+  env.measurements->GetOpStats(report.stats);
+  // operations the DB wrappers measured, the rest were warmup
+  int measured_ops = 0;
+  for (int i = 0; i < ycsbc::MAXOPTYPE; i++) {
+    if (!ycsbc::IsBatchOperation(static_cast<ycsbc::Operation>(i))) {
+      measured_ops += report.stats[i].count;
     }
+  }
 
-    std::cout << "Load runtime(sec): " << runtime << std::endl;
-    std::cout << "Load operations(ops): " << sum << std::endl;
-    std::cout << "Load throughput(ops/sec): " << sum / runtime << std::endl;
+  std::cout << "Run total runtime(sec): " << total_runtime << std::endl;
+  std::cout << "Run measurement runtime(sec): " << measurement_runtime << std::endl;
+  std::cout << "Run total operations(ops): " << sum << std::endl;
+  std::cout << "Run warmup operations(ops): " << sum - measured_ops << std::endl;
+  std::cout << "Run measured operations(ops): " << measured_ops << std::endl;
+  if (epoch.started()) {
+    std::cout << "Run measured throughput(ops/sec): " << measured_ops / measurement_runtime << std::endl;
+  } else {
+    std::cout << "Run measured throughput(ops/sec): none, the clients finished during the warmup" << std::endl;
   }
 
-  measurements->Reset();
-  std::this_thread::sleep_for(std::chrono::seconds(stoi(props.GetProperty("sleepafterload", "0"))));
+  report.name = name;
+  report.runtime = measurement_runtime;
+  report.total_runtime = total_runtime;
+  report.warmup_operations = sum - measured_ops;
+  report.operations = measured_ops;
+  return report;
+}
 
+// Properties of phase name: the global ones with what the previous phases
+// left (carried) set, overridden by phase.<name>.<key>
+ycsbc::utils::Properties PhaseProperties(const ycsbc::utils::Properties &props, const std::string &name,
+                                         const std::string &carried_key, uint64_t carried_value) {
+  ycsbc::utils::Properties phase_props = props;
+  phase_props.SetProperty(carried_key, std::to_string(carried_value));
+  const std::string prefix = "phase." + name + ".";
+  for (const auto &prop : props.properties()) {
+    if (prop.first.compare(0, prefix.size(), prefix) == 0) {
+      phase_props.SetProperty(prop.first.substr(prefix.size()), prop.second);
+    }
+  }
+  return phase_props;
+}
 
-  // transaction phase
-  if (do_transaction) {
-    // initial ops per second, unlimited if <= 0
-    const int64_t ops_limit = std::stoi(props.GetProperty("limit.ops", "0"));
-    // rate file path for dynamic rate limiting, format "time_stamp_sec new_ops_per_second" per line
-    std::string rate_file = props.GetProperty("limit.file", "");
+// Value of key in phase name: phase.<name>.<key>, or else the global one
+std::string PhaseProperty(const ycsbc::utils::Properties &props, const std::string &name,
+                          const std::string &key, const std::string &default_value) {
+  return props.GetProperty("phase." + name + "." + key, props.GetProperty(key, default_value));
+}
 
-    const int total_ops = stoi(props[ycsbc::CoreWorkload::OPERATION_COUNT_PROPERTY]);
-    const int non_warmup_ops = total_ops - warmup_ops;
+std::string PhaseType(const ycsbc::utils::Properties &props, const std::string &name) {
+  return PhaseProperty(props, name, "type", name.compare(0, 4, "load") == 0 ? "load" : "run");
+}
 
-    ycsbc::utils::CountDownLatch latch(num_threads);
-    ycsbc::utils::Timer<double> timer;
+// Runs the phases of the phases property, e.g. "load,warm,run_a,run_e", one
+// after the other in this process. Each phase takes the global properties
+// overridden by phase.<name>.<key>, so it can have its own threadcount,
+// operationcount, maxexecutiontime, limit.* and workload mix. The type of a
+// phase (phase.<name>.type) is load, bulkload or run, by default load for
+// names starting with "load" and run otherwise. A run phase starts with
+// recordcount set to the keys the previous phases inserted; a load phase
+// inserts its recordcount keys from an insertstart that follows on from them,
+// so a second load adds keys instead of overwriting the first. The DB is
+// opened once, with the global properties, and stays open until the last
+// phase is done, so later phases see the caches the earlier ones warmed.
+void RunPhases(const PhaseEnv &env, ycsbc::utils::Properties &props, ycsbc::TraceWriter *trace,
+               std::vector<PhaseReport> *reports) {
+  std::vector<std::string> names;
+  std::stringstream list(props.GetProperty("phases"));
+  std::string name;
+  while (std::getline(list, name, ',')) {
+    name = ycsbc::utils::Trim(name);
+    if (name.empty()) {
+      continue;
+    }
+    if (std::find(names.begin(), names.end(), name) != names.end()) {
+      std::cerr << "Duplicate phase " << name << std::endl;
+      exit(1);
+    }
+    names.push_back(name);
+  }
+  // random transaction inserts scatter their keys over a sparse range the
+  // next phase would not know about, and would insert them again
+  for (size_t i = 0; i + 1 < names.size(); i++) {
+    if (PhaseType(props, names[i]) == "run" &&
+        PhaseProperty(props, names[i], ycsbc::CoreWorkload::INSERT_ORDER_PROPERTY,
+                      ycsbc::CoreWorkload::INSERT_ORDER_DEFAULT) == "random" &&
+        std::stod(PhaseProperty(props, names[i], ycsbc::CoreWorkload::INSERT_PROPORTION_PROPERTY,
+                                ycsbc::CoreWorkload::INSERT_PROPORTION_DEFAULT)) > 0) {
+      std::cerr << "Phase " << names[i] << " inserts with insertorder=random, which only the last phase can do"
+                << std::endl;
+      exit(1);
+    }
+  }
 
-    timer.Start();
-    std::future<void> status_future;
-    if (show_status) {
-      status_future = std::async(std::launch::async, StatusThread,
-                                 measurements, &latch, status_interval);
+  // client threads open and close the DB in every phase; this reference
+  // keeps it open in between
+  std::unique_ptr<ycsbc::DB> anchor(ycsbc::DBFactory::CreateDB(&props, env.measurements, nullptr, trace));
+  if (anchor == nullptr) {
+    std::cerr << "Unknown database name " << props.GetProperty("dbname") << std::endl;
+    exit(1);
+  }
+  anchor->Init();
+
+  uint64_t records = std::stoull(props[ycsbc::CoreWorkload::RECORD_COUNT_PROPERTY]);
+  uint64_t insert_start = std::stoull(props.GetProperty(ycsbc::CoreWorkload::INSERT_START_PROPERTY,
+                                                        ycsbc::CoreWorkload::INSERT_START_DEFAULT));
+  // thread ids keep counting across phases so every phase draws fresh streams
+  int first_thread_id = 0;
+  for (const std::string &name : names) {
+    const std::string type = PhaseType(props, name);
+    if (type != "load" && type != "bulkload" && type != "run") {
+      std::cerr << "Unknown type " << type << " of phase " << name << std::endl;
+      exit(1);
     }
-    
-    // Wait for warmup operations to complete before starting measurement timer
-    ycsbc::utils::CountDownLatch warmup_latch(num_threads);
-    std::atomic<bool> measurement_started(false);
-    ycsbc::utils::Timer<double> measurement_timer;
-    
-    std::vector<std::future<int>> client_threads;
-    std::vector<ycsbc::utils::RateLimiter *> rate_limiters;
-    for (int i = 0; i < num_threads; ++i) {
-      int thread_ops = total_ops / num_threads;
-      if (i < total_ops % num_threads) {
-        thread_ops++;
+    ycsbc::utils::Properties phase_props =
+        type == "run" ? PhaseProperties(props, name, ycsbc::CoreWorkload::RECORD_COUNT_PROPERTY, records)
+                      : PhaseProperties(props, name, ycsbc::CoreWorkload::INSERT_START_PROPERTY, insert_start);
+    const int num_threads = stoi(phase_props.GetProperty("threadcount", "1"));
+    const ycsbc::utils::ThreadPlacement placement(phase_props.GetProperty("cpu.affinity", ""),
+                                                  phase_props.GetProperty("numa.policy", "none"));
+    std::unique_ptr<ycsbc::CoreWorkload> wl = CreateWorkload(phase_props);
+
+    std::cout << "Phase " << name << " (" << type << ")" << std::endl;
+    if (type == "run") {
+      const int total_ops = stoi(phase_props[ycsbc::CoreWorkload::OPERATION_COUNT_PROPERTY]);
+      std::atomic<bool> measuring(false);
+      std::vector<ycsbc::DB *> dbs = CreateDBs(&phase_props, env.measurements, num_threads, &measuring, trace);
+      reports->push_back(RunTransactionPhase(env, name, phase_props, *wl, dbs, &measuring, placement, total_ops,
+                                             true, true, first_thread_id));
+      for (ycsbc::DB *db : dbs) {
+        delete db;
       }
-      ycsbc::utils::RateLimiter *rlim = nullptr;
-      if (ops_limit > 0 || rate_file != "") {
-        int64_t per_thread_ops = ops_limit / num_threads;
-        rlim = new ycsbc::utils::RateLimiter(per_thread_ops, per_thread_ops);
+    } else {
+      const int total_ops = stoi(phase_props[ycsbc::CoreWorkload::RECORD_COUNT_PROPERTY]);
+      std::vector<ycsbc::DB *> dbs = CreateDBs(&phase_props, env.measurements, num_threads, nullptr, trace);
+      env.measurements->SetWarmupTarget(0);
+      reports->push_back(RunLoadPhase(env, name, *wl, dbs, placement, total_ops, type == "bulkload",
+                                      true, true, first_thread_id));
+      for (ycsbc::DB *db : dbs) {
+        delete db;
       }
-      rate_limiters.push_back(rlim);
-      client_threads.emplace_back(std::async(std::launch::async, ycsbc::ClientThreadWithWarmup, dbs[i], &wl,
-                                             thread_ops, false, !do_load, true, &latch, &warmup_latch, 
-                                             &measurement_started, &measurement_timer, 
-                                             warmup_ops / num_threads + (i < warmup_ops % num_threads ? 1 : 0), rlim));
     }
 
-    std::future<void> rlim_future;
-    if (rate_file != "") {
-      rlim_future = std::async(std::launch::async, RateLimitThread, rate_file, rate_limiters, &latch);
+    if (type == "run") {
+      records = wl->record_count();
+    } else {
+      records = wl->insert_start() + std::stoull(phase_props[ycsbc::CoreWorkload::RECORD_COUNT_PROPERTY]);
     }
+    insert_start = records;
+    first_thread_id += num_threads;
+    env.measurements->Reset();
+    std::this_thread::sleep_for(std::chrono::duration<double>(std::stod(phase_props.GetProperty("sleepafter", "0"))));
+  }
+
+  anchor->Cleanup();
+}
+
+int main(const int argc, const char *argv[]) {
+  ycsbc::utils::Properties props;
+  ParseCommandLine(argc, argv, props);
+
+  const bool do_bulkload = (props.GetProperty("dobulkload", "false") == "true");
+  const bool do_load = do_bulkload || (props.GetProperty("doload", "false") == "true");
+  const bool do_transaction = (props.GetProperty("dotransaction", "false") == "true");
+  // a list of phases replaces -load and -run, see RunPhases
+  const bool do_phases = !props.GetProperty("phases", "").empty();
+  if (do_phases && (do_load || do_transaction)) {
+    std::cerr << "phases cannot be combined with -load or -run" << std::endl;
+    exit(1);
+  }
+  if (!do_load && !do_transaction && !do_phases) {
+    std::cerr << "No operation to do" << std::endl;
+    exit(1);
+  }
+
+  ycsbc::Measurements *measurements = ycsbc::CreateMeasurements(&props);
+  if (measurements == nullptr) {
+    std::cerr << "Unknown measurements name" << std::endl;
+    exit(1);
+  }
 
-    assert((int)client_threads.size() == num_threads);
+  // every operation of the run is recorded for replay with workload=trace
+  std::unique_ptr<ycsbc::TraceWriter> trace_writer;
+  const std::string trace_record_file = props.GetProperty("trace.record.file", "");
+  if (!trace_record_file.empty()) {
+    trace_writer.reset(new ycsbc::TraceWriter(trace_record_file));
+  }
 
-    int sum = 0;
-    for (auto &n : client_threads) {
-      assert(n.valid());
-      sum += n.get();
+  // print status periodically
+  const bool show_status = (props.GetProperty("status", "false") == "true");
+  const double status_interval = std::stod(props.GetProperty("status.interval", "10"));
+  // poll the engine for memtable, compaction and cache statistics on the same ticks
+  const bool engine_stats = (props.GetProperty("status.engine_stats", "false") == "true");
+
+  // per-interval throughput and latency, one JSON object per line and status interval
+  const std::string timeseries_file = props.GetProperty("measurement.timeseries.file", "");
+  std::ofstream timeseries;
+  if (!timeseries_file.empty()) {
+    timeseries.open(timeseries_file);
+    if (!timeseries.is_open()) {
+      std::cerr << "Failed to open time-series file " << timeseries_file << std::endl;
+      exit(1);
+    }
+  }
+  const PhaseEnv env = {measurements, show_status, status_interval,
+                        timeseries.is_open() ? &timeseries : nullptr, engine_stats};
+
+  // final report with the full latency distribution, one JSON document
+  const std::string report_file = props.GetProperty("measurement.report.file", "");
+  std::ofstream report;
+  if (!report_file.empty()) {
+    report.open(report_file);
+    if (!report.is_open()) {
+      std::cerr << "Failed to open report file " << report_file << std::endl;
+      exit(1);
     }
-    double total_runtime = timer.End();
-    double measurement_runtime = measurement_timer.End();
+  }
+  std::vector<PhaseReport> phase_reports;
 
-    if (show_status) {
-      status_future.wait();
+  if (do_phases) {
+    RunPhases(env, props, trace_writer.get(), &phase_reports);
+  } else {
+    const int num_threads = stoi(props.GetProperty("threadcount", "1"));
+
+    // client thread i is pinned to the i-th cpu of the list, e.g. "0-7,16-23"
+    const ycsbc::utils::ThreadPlacement placement(props.GetProperty("cpu.affinity", ""),
+                                                  props.GetProperty("numa.policy", "none"));
+
+    std::unique_ptr<ycsbc::CoreWorkload> workload = CreateWorkload(props);
+    ycsbc::CoreWorkload &wl = *workload;
+
+    // set while operations are measured; the load is, the warmup of the run is not
+    std::atomic<bool> measuring(true);
+    std::vector<ycsbc::DB *> dbs = CreateDBs(&props, measurements, num_threads, &measuring, trace_writer.get());
+
+    // load phase
+    if (do_load) {
+      const int total_ops = stoi(props[ycsbc::CoreWorkload::RECORD_COUNT_PROPERTY]);
+      phase_reports.push_back(RunLoadPhase(env, "load", wl, dbs, placement, total_ops, do_bulkload,
+                                           true, !do_transaction, 0));
+    }
+
+    measurements->Reset();
+    std::this_thread::sleep_for(std::chrono::seconds(stoi(props.GetProperty("sleepafterload", "0"))));
+
+    // transaction phase
+    if (do_transaction) {
+      const int total_ops = stoi(props[ycsbc::CoreWorkload::OPERATION_COUNT_PROPERTY]);
+      // thread ids continue after the load threads so run streams differ from load streams
+      phase_reports.push_back(RunTransactionPhase(env, "run", props, wl, dbs, &measuring, placement, total_ops,
+                                                  !do_load, true, num_threads));
     }
 
-    std::cout << "Run total runtime(sec): " << total_runtime << std::endl;
-    std::cout << "Run measurement runtime(sec): " << measurement_runtime << std::endl;
-    std::cout << "Run total operations(ops): " << sum << std::endl;
-    std::cout << "Run warmup operations(ops): " << warmup_ops << std::endl;
-    std::cout << "Run measured operations(ops): " << non_warmup_ops << std::endl;
-    std::cout << "Run measured throughput(ops/sec): " << non_warmup_ops / measurement_runtime << std::endl;
+    for (int i = 0; i < num_threads; i++) {
+      delete dbs[i];
+    }
   }
 
-  for (int i = 0; i < num_threads; i++) {
-    delete dbs[i];
+  if (report.is_open()) {
+    WriteReport(report, props, phase_reports);
+  }
+  if (trace_writer) {
+    trace_writer->Close();
   }
 }
 
@@ -260,6 +808,9 @@ void ParseCommandLine(int argc, const char *argv[], ycsbc::utils::Properties &pr
     if (strcmp(argv[argindex], "-load") == 0) {
       props.SetProperty("doload", "true");
       argindex++;
+    } else if (strcmp(argv[argindex], "-bulkload") == 0) {
+      props.SetProperty("dobulkload", "true");
+      argindex++;
     } else if (strcmp(argv[argindex], "-run") == 0 || strcmp(argv[argindex], "-t") == 0) {
       props.SetProperty("dotransaction", "true");
       argindex++;
@@ -336,6 +887,8 @@ void UsageMessage(const char *command) {
       "Usage: " << command << " [options]\n"
       "Options:\n"
       "  -load: run the loading phase of the workload\n"
+      "  -bulkload: run the loading phase by building and ingesting sorted files\n"
+      "             (rocksdb family only)\n"
       "  -t: run the transactions phase of the workload\n"
       "  -run: same as -t\n"
       "  -threads n: execute using n threads (default: 1)\n"
@@ -345,7 +898,8 @@ void UsageMessage(const char *command) {
       "  -p name=value: specify a property to be passed to the DB and workloads\n"
       "                 multiple properties can be specified, and override any\n"
       "                 values in the propertyfile\n"
-      "  -s: print status every 10 seconds (use status.interval prop to override)"
+      "  -s: print status every 10 seconds (use status.interval prop to override,\n"
+      "      fractional seconds are allowed)"
       << std::endl;
 }
 
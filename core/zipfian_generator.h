@@ -12,9 +12,9 @@
 #include <cassert>
 #include <cmath>
 #include <cstdint>
-#include <mutex>
 
 #include "generator.h"
+#include "utils/random.h"
 #include "utils/utils.h"
 
 namespace ycsbc {
@@ -44,12 +44,21 @@ class ZipfianGenerator : public Generator<uint64_t> {
     Next();
   }
 
+  // Copies the computed parameters of other, drawing from a stream seeded by seed
+  ZipfianGenerator(const ZipfianGenerator &other, uint64_t seed) :
+      items_(other.items_), base_(other.base_), theta_(other.theta_), zeta_n_(other.zeta_n_),
+      eta_(other.eta_), alpha_(other.alpha_), zeta_2_(other.zeta_2_),
+      count_for_zeta_(other.count_for_zeta_), last_value_(other.last_value_),
+      allow_count_decrease_(other.allow_count_decrease_), rng_(seed) {}
+
   uint64_t Next(uint64_t num_items);
 
   uint64_t Next() { return Next(items_); }
 
   uint64_t Last();
 
+  ZipfianGenerator *Clone(uint64_t seed) const override { return new ZipfianGenerator(*this, seed); }
+
  private:
   double Eta() {
     return (1 - std::pow(2.0 / items_, 1 - theta_)) / (1 - zeta_2_ / zeta_n_);
@@ -69,10 +78,30 @@ class ZipfianGenerator : public Generator<uint64_t> {
     return zeta;
   }
 
+  ///
+  /// Zeta of num items in time independent of num: the first kZetaExactTerms
+  /// terms are summed, the rest is the Euler-Maclaurin expansion of the sum
+  /// up to the third derivative, whose error at that cut-off is below double
+  /// precision.
+  ///
   static double Zeta(uint64_t num, double theta) {
-    return Zeta(0, num, theta, 0);
+    if (num <= kZetaExactTerms) {
+      return Zeta(0, num, theta, 0);
+    }
+    const double a = kZetaExactTerms;
+    const double b = num;
+    auto f = [theta](double x) { return std::pow(x, -theta); };
+    auto f1 = [theta](double x) { return -theta * std::pow(x, -theta - 1); };
+    auto f3 = [theta](double x) { return -theta * (theta + 1) * (theta + 2) * std::pow(x, -theta - 3); };
+    const double integral = theta == 1.0 ? std::log(b / a)
+                                         : (std::pow(b, 1 - theta) - std::pow(a, 1 - theta)) / (1 - theta);
+    // sum over [a, b] minus the term at a, which the exact part already holds
+    const double tail = integral + (f(a) + f(b)) / 2 + (f1(b) - f1(a)) / 12 - (f3(b) - f3(a)) / 720 - f(a);
+    return Zeta(0, kZetaExactTerms, theta, 0) + tail;
   }
 
+  static constexpr uint64_t kZetaExactTerms = 1024;
+
   uint64_t items_;
   uint64_t base_; /// Min number of items to generate
 
@@ -80,17 +109,18 @@ class ZipfianGenerator : public Generator<uint64_t> {
   double theta_, zeta_n_, eta_, alpha_, zeta_2_;
   uint64_t count_for_zeta_; /// Number of items used to compute zeta_n
   uint64_t last_value_;
-  std::mutex mutex_;
   bool allow_count_decrease_;
+  utils::Xoshiro256 rng_;
 };
 
 inline uint64_t ZipfianGenerator::Next(uint64_t num) {
   assert(num >= 2 && num < kMaxNumItems);
   if (num != count_for_zeta_) {
-    // recompute zeta and eta
-    std::lock_guard<std::mutex> lock(mutex_);
+    // recompute zeta and eta; every thread owns its generator, so no lock
     if (num > count_for_zeta_) {
-      zeta_n_ = Zeta(count_for_zeta_, num, theta_, zeta_n_);
+      // a few new items are summed onto the old zeta, larger growth is recomputed
+      zeta_n_ = num - count_for_zeta_ <= kZetaExactTerms ? Zeta(count_for_zeta_, num, theta_, zeta_n_)
+                                                          : Zeta(num, theta_);
       count_for_zeta_ = num;
       eta_ = Eta();
     } else if (num < count_for_zeta_ && allow_count_decrease_) {
@@ -98,7 +128,7 @@ inline uint64_t ZipfianGenerator::Next(uint64_t num) {
     }
   }
 
-  double u = utils::ThreadLocalRandomDouble();
+  double u = rng_.NextDouble();
   double uz = u * zeta_n_;
 
   if (uz < 1.0) {
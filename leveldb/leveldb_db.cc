@@ -64,6 +64,7 @@ void LeveldbDB::Init() {
     format_ = kSingleEntry;
     method_read_ = &LeveldbDB::ReadSingleEntry;
     method_scan_ = &LeveldbDB::ScanSingleEntry;
+    method_scan_visit_ = &LeveldbDB::ScanVisitSingleEntry;
     method_update_ = &LeveldbDB::UpdateSingleEntry;
     method_insert_ = &LeveldbDB::InsertSingleEntry;
     method_delete_ = &LeveldbDB::DeleteSingleEntry;
@@ -71,6 +72,7 @@ void LeveldbDB::Init() {
     format_ = kRowMajor;
     method_read_ = &LeveldbDB::ReadCompKeyRM;
     method_scan_ = &LeveldbDB::ScanCompKeyRM;
+    method_scan_visit_ = &LeveldbDB::ScanVisitCompKey;
     method_update_ = &LeveldbDB::InsertCompKey;
     method_insert_ = &LeveldbDB::InsertCompKey;
     method_delete_ = &LeveldbDB::DeleteCompKey;
@@ -78,6 +80,7 @@ void LeveldbDB::Init() {
     format_ = kColumnMajor;
     method_read_ = &LeveldbDB::ReadCompKeyCM;
     method_scan_ = &LeveldbDB::ScanCompKeyCM;
+    method_scan_visit_ = &LeveldbDB::ScanVisitCompKey;
     method_update_ = &LeveldbDB::InsertCompKey;
     method_insert_ = &LeveldbDB::InsertCompKey;
     method_delete_ = &LeveldbDB::DeleteCompKey;
@@ -88,6 +91,7 @@ void LeveldbDB::Init() {
                                             CoreWorkload::FIELD_COUNT_DEFAULT));
   field_prefix_ = props.GetProperty(CoreWorkload::FIELD_NAME_PREFIX,
                                     CoreWorkload::FIELD_NAME_PREFIX_DEFAULT);
+  codec_.Init(props);
 
   ref_cnt_++;
   if (db_) {
@@ -170,59 +174,6 @@ void LeveldbDB::GetOptions(const utils::Properties &props, leveldb::Options *opt
   }
 }
 
-void LeveldbDB::SerializeRow(const std::vector<Field> &values, std::string *data) {
-  for (const Field &field : values) {
-    uint32_t len = field.name.size();
-    data->append(reinterpret_cast<char *>(&len), sizeof(uint32_t));
-    data->append(field.name.data(), field.name.size());
-    len = field.value.size();
-    data->append(reinterpret_cast<char *>(&len), sizeof(uint32_t));
-    data->append(field.value.data(), field.value.size());
-  }
-}
-
-void LeveldbDB::DeserializeRowFilter(std::vector<Field> *values, const std::string &data,
-                                     const std::vector<std::string> &fields) {
-  const char *p = data.data();
-  const char *lim = p + data.size();
-
-  std::vector<std::string>::const_iterator filter_iter = fields.begin();
-  while (p != lim && filter_iter != fields.end()) {
-    assert(p < lim);
-    uint32_t len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string field(p, static_cast<const size_t>(len));
-    p += len;
-    len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string value(p, static_cast<const size_t>(len));
-    p += len;
-    if (*filter_iter == field) {
-      values->push_back({field, value});
-      filter_iter++;
-    }
-  }
-  assert(values->size() == fields.size());
-}
-
-void LeveldbDB::DeserializeRow(std::vector<Field> *values, const std::string &data) {
-  const char *p = data.data();
-  const char *lim = p + data.size();
-  while (p != lim) {
-    assert(p < lim);
-    uint32_t len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string field(p, static_cast<const size_t>(len));
-    p += len;
-    len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string value(p, static_cast<const size_t>(len));
-    p += len;
-    values->push_back({field, value});
-  }
-  assert(values->size() == fieldcount_);
-}
-
 std::string LeveldbDB::BuildCompKey(const std::string &key, const std::string &field_name) {
   switch (format_) {
     case kRowMajor:
@@ -258,11 +209,7 @@ DB::Status LeveldbDB::ReadSingleEntry(const std::string &table, const std::strin
   } else if (!s.ok()) {
     throw utils::Exception(std::string("LevelDB Get: ") + s.ToString());
   }
-  if (fields != nullptr) {
-    DeserializeRowFilter(&result, data, *fields);
-  } else {
-    DeserializeRow(&result, data);
-  }
+  codec_.Deserialize(result, data, fields);
   return kOK;
 }
 
@@ -275,10 +222,25 @@ DB::Status LeveldbDB::ScanSingleEntry(const std::string &table, const std::strin
     std::string data = db_iter->value().ToString();
     result.push_back(std::vector<Field>());
     std::vector<Field> &values = result.back();
-    if (fields != nullptr) {
-      DeserializeRowFilter(&values, data, *fields);
-    } else {
-      DeserializeRow(&values, data);
+    codec_.Deserialize(values, data, fields);
+    db_iter->Next();
+  }
+  delete db_iter;
+  return kOK;
+}
+
+DB::Status LeveldbDB::ScanVisitSingleEntry(const std::string &table, const std::string &key, int len,
+                                           const std::vector<std::string> *fields,
+                                           const ScanVisitor &visitor) {
+  leveldb::Iterator *db_iter = db_->NewIterator(leveldb::ReadOptions());
+  db_iter->Seek(key);
+  for (int i = 0; db_iter->Valid() && i < len; i++) {
+    // the value slice stays valid until the iterator moves
+    leveldb::Slice data = db_iter->value();
+    scan_row_.clear();
+    codec_.DeserializeView(scan_row_, data.data(), data.size(), fields);
+    if (!visitor(scan_row_)) {
+      break;
     }
     db_iter->Next();
   }
@@ -295,23 +257,10 @@ DB::Status LeveldbDB::UpdateSingleEntry(const std::string &table, const std::str
   } else if (!s.ok()) {
     throw utils::Exception(std::string("LevelDB Get: ") + s.ToString());
   }
-  std::vector<Field> current_values;
-  DeserializeRow(&current_values, data);
-  for (Field &new_field : values) {
-    bool found MAYBE_UNUSED = false;
-    for (Field &cur_field : current_values) {
-      if (cur_field.name == new_field.name) {
-        found = true;
-        cur_field.value = new_field.value;
-        break;
-      }
-    }
-    assert(found);
-  }
+  // patches the changed fields into the fetched row
+  codec_.Update(data, values);
   leveldb::WriteOptions wopt;
 
-  data.clear();
-  SerializeRow(current_values, &data);
   s = db_->Put(wopt, key, data);
   if (!s.ok()) {
     throw utils::Exception(std::string("LevelDB Put: ") + s.ToString());
@@ -322,7 +271,7 @@ DB::Status LeveldbDB::UpdateSingleEntry(const std::string &table, const std::str
 DB::Status LeveldbDB::InsertSingleEntry(const std::string &table, const std::string &key,
                                         std::vector<Field> &values) {
   std::string data;
-  SerializeRow(values, &data);
+  codec_.Serialize(values, data);
   leveldb::WriteOptions wopt;
   leveldb::Status s = db_->Put(wopt, key, data);
   if (!s.ok()) {
@@ -340,6 +289,61 @@ DB::Status LeveldbDB::DeleteSingleEntry(const std::string &table, const std::str
   return kOK;
 }
 
+DB::Status LeveldbDB::BatchRead(const std::string &table, const std::vector<std::string> &keys,
+                                const std::vector<std::string> *fields,
+                                std::vector<std::vector<Field>> &results, std::vector<Status> &statuses) {
+  if (format_ != kSingleEntry) {
+    return DB::BatchRead(table, keys, fields, results, statuses);
+  }
+  // LevelDB has no multi-get; read every key from one snapshot instead
+  leveldb::ReadOptions ropt;
+  ropt.snapshot = db_->GetSnapshot();
+  results.clear();
+  results.resize(keys.size());
+  statuses.assign(keys.size(), kOK);
+  Status ret = kOK;
+  std::string data;
+  for (size_t i = 0; i < keys.size(); i++) {
+    data.clear();
+    leveldb::Status s = db_->Get(ropt, keys[i], &data);
+    if (s.IsNotFound()) {
+      ret = statuses[i] = kNotFound;
+      continue;
+    } else if (!s.ok()) {
+      db_->ReleaseSnapshot(ropt.snapshot);
+      throw utils::Exception(std::string("LevelDB Get: ") + s.ToString());
+    }
+    codec_.Deserialize(results[i], data, fields);
+  }
+  db_->ReleaseSnapshot(ropt.snapshot);
+  return ret;
+}
+
+DB::Status LeveldbDB::BatchWrite(const std::string &table, const std::vector<std::string> &keys,
+                                 std::vector<std::vector<Field>> &values) {
+  leveldb::WriteOptions wopt;
+  leveldb::WriteBatch batch;
+
+  std::string data;
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (format_ == kSingleEntry) {
+      data.clear();
+      codec_.Serialize(values[i], data);
+      batch.Put(keys[i], data);
+    } else {
+      for (Field &field : values[i]) {
+        batch.Put(BuildCompKey(keys[i], field.name), field.value);
+      }
+    }
+  }
+
+  leveldb::Status s = db_->Write(wopt, &batch);
+  if (!s.ok()) {
+    throw utils::Exception(std::string("LevelDB Write: ") + s.ToString());
+  }
+  return kOK;
+}
+
 DB::Status LeveldbDB::ReadCompKeyRM(const std::string &table, const std::string &key,
                                     const std::vector<std::string> *fields,
                                     std::vector<Field> &result) {
@@ -438,6 +442,12 @@ DB::Status LeveldbDB::ScanCompKeyCM(const std::string &table, const std::string
   return kNotImplemented;
 }
 
+DB::Status LeveldbDB::ScanVisitCompKey(const std::string &table, const std::string &key, int len,
+                                       const std::vector<std::string> *fields,
+                                       const ScanVisitor &visitor) {
+  return DB::ScanVisit(table, key, len, fields, visitor);
+}
+
 DB::Status LeveldbDB::InsertCompKey(const std::string &table, const std::string &key,
                                     std::vector<Field> &values) {
   leveldb::WriteOptions wopt;
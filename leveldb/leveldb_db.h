@@ -13,6 +13,7 @@
 #include <mutex>
 
 #include "core/db.h"
+#include "core/row_codec.h"
 #include "utils/properties.h"
 
 #include <leveldb/db.h>
@@ -42,6 +43,11 @@ class LeveldbDB : public DB {
     return (this->*(method_scan_))(table, key, len, fields, result);
   }
 
+  Status ScanVisit(const std::string &table, const std::string &key, int len,
+                   const std::vector<std::string> *fields, const ScanVisitor &visitor) {
+    return (this->*(method_scan_visit_))(table, key, len, fields, visitor);
+  }
+
   Status Update(const std::string &table, const std::string &key, std::vector<Field> &values) {
     return (this->*(method_update_))(table, key, values);
   }
@@ -54,6 +60,13 @@ class LeveldbDB : public DB {
     return (this->*(method_delete_))(table, key);
   }
 
+  Status BatchRead(const std::string &table, const std::vector<std::string> &keys,
+                   const std::vector<std::string> *fields,
+                   std::vector<std::vector<Field>> &results, std::vector<Status> &statuses);
+
+  Status BatchWrite(const std::string &table, const std::vector<std::string> &keys,
+                    std::vector<std::vector<Field>> &values);
+
  private:
   enum LdbFormat {
     kSingleEntry,
@@ -63,10 +76,6 @@ class LeveldbDB : public DB {
   LdbFormat format_;
 
   void GetOptions(const utils::Properties &props, leveldb::Options *opt);
-  void SerializeRow(const std::vector<Field> &values, std::string *data);
-  void DeserializeRowFilter(std::vector<Field> *values, const std::string &data,
-                            const std::vector<std::string> &fields);
-  void DeserializeRow(std::vector<Field> *values, const std::string &data);
   std::string BuildCompKey(const std::string &key, const std::string &field_name);
   std::string KeyFromCompKey(const std::string &comp_key);
   std::string FieldFromCompKey(const std::string &comp_key);
@@ -76,6 +85,8 @@ class LeveldbDB : public DB {
   Status ScanSingleEntry(const std::string &table, const std::string &key, int len,
                          const std::vector<std::string> *fields,
                          std::vector<std::vector<Field>> &result);
+  Status ScanVisitSingleEntry(const std::string &table, const std::string &key, int len,
+                              const std::vector<std::string> *fields, const ScanVisitor &visitor);
   Status UpdateSingleEntry(const std::string &table, const std::string &key,
                            std::vector<Field> &values);
   Status InsertSingleEntry(const std::string &table, const std::string &key,
@@ -92,6 +103,10 @@ class LeveldbDB : public DB {
   Status ScanCompKeyCM(const std::string &table, const std::string &key, int len,
                        const std::vector<std::string> *fields,
                        std::vector<std::vector<Field>> &result);
+  // the composite key formats spread a row over several entries and scan
+  // through the materializing default
+  Status ScanVisitCompKey(const std::string &table, const std::string &key, int len,
+                          const std::vector<std::string> *fields, const ScanVisitor &visitor);
   Status InsertCompKey(const std::string &table, const std::string &key,
                        std::vector<Field> &values);
   Status DeleteCompKey(const std::string &table, const std::string &key);
@@ -101,6 +116,9 @@ class LeveldbDB : public DB {
   Status (LeveldbDB::*method_scan_)(const std::string &, const std::string &, int,
                                     const std::vector<std::string> *,
                                     std::vector<std::vector<Field>> &);
+  Status (LeveldbDB::*method_scan_visit_)(const std::string &, const std::string &, int,
+                                          const std::vector<std::string> *,
+                                          const ScanVisitor &);
   Status (LeveldbDB::*method_update_)(const std::string &, const std::string &,
                                       std::vector<Field> &);
   Status (LeveldbDB::*method_insert_)(const std::string &, const std::string &,
@@ -108,6 +126,7 @@ class LeveldbDB : public DB {
   Status (LeveldbDB::*method_delete_)(const std::string &, const std::string &);
 
   int fieldcount_;
+  RowCodec codec_;
   std::string field_prefix_;
 
   static leveldb::DB *db_;
@@ -46,9 +46,6 @@ namespace {
 
 namespace ycsbc {
 
-size_t LmdbDB::field_count_;
-std::string LmdbDB::field_prefix_;
-
 MDB_env *LmdbDB::env_;
 MDB_dbi LmdbDB::dbi_;
 int LmdbDB::ref_cnt_ = 0;
@@ -58,16 +55,12 @@ void LmdbDB::Init() {
   const std::lock_guard<std::mutex> lock(mutex_);
 
   const utils::Properties &props = *props_;
+  codec_.Init(props);
 
   if (ref_cnt_++) {
     return;
   }
 
-  field_count_ = std::stoi(props.GetProperty(CoreWorkload::FIELD_COUNT_PROPERTY,
-                                            CoreWorkload::FIELD_COUNT_DEFAULT));
-  field_prefix_ = props.GetProperty(CoreWorkload::FIELD_NAME_PREFIX,
-                                    CoreWorkload::FIELD_NAME_PREFIX_DEFAULT);
-
   int ret;
   int env_opt = 0;
   if (props.GetProperty(PROP_NOSYNC, PROP_NOSYNC_DEFAULT) == "true") {
@@ -125,6 +118,7 @@ void LmdbDB::Init() {
 }
 
 void LmdbDB::Cleanup() {
+  ReleaseView();
   const std::lock_guard<std::mutex> lock(mutex_);
   if (--ref_cnt_) {
     return;
@@ -133,60 +127,16 @@ void LmdbDB::Cleanup() {
   mdb_env_close(env_);
 }
 
-void LmdbDB::SerializeRow(const std::vector<Field> &values, std::string *data) {
-  for (const Field &field : values) {
-    uint32_t len = field.name.size();
-    data->append(reinterpret_cast<char *>(&len), sizeof(uint32_t));
-    data->append(field.name.data(), field.name.size());
-    len = field.value.size();
-    data->append(reinterpret_cast<char *>(&len), sizeof(uint32_t));
-    data->append(field.value.data(), field.value.size());
-  }
-}
-
-void LmdbDB::DeserializeRowFilter(std::vector<Field> *values, const char *data_ptr, size_t data_len,
-                                  const std::vector<std::string> &fields) {
-  const char *p = data_ptr;
-  const char *lim = p + data_len;
-  std::vector<std::string>::const_iterator filter_iter = fields.begin();
-  while (p != lim && filter_iter != fields.end()) {
-    assert(p < lim);
-    uint32_t len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string field(p, static_cast<const size_t>(len));
-    p += len;
-    len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string value(p, static_cast<const size_t>(len));
-    p += len;
-    if (*filter_iter == field) {
-      values->push_back({field, value});
-      filter_iter++;
-    }
+void LmdbDB::ReleaseView() {
+  if (view_txn_ != nullptr) {
+    mdb_txn_abort(view_txn_);
+    view_txn_ = nullptr;
   }
-  assert(values->size() == fields.size());
-}
-
-void LmdbDB::DeserializeRow(std::vector<Field> *values, const char *data_ptr, size_t data_len) {
-  const char *p = data_ptr;
-  const char *lim = p + data_len;
-  while (p != lim) {
-    assert(p < lim);
-    uint32_t len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string field(p, static_cast<const size_t>(len));
-    p += len;
-    len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string value(p, static_cast<const size_t>(len));
-    p += len;
-    values->push_back({field, value});
-  }
-  assert(values->size() == field_count_);
 }
 
 DB::Status LmdbDB::Read(const std::string &table, const std::string &key, const std::vector<std::string> *fields,
                         std::vector<Field> &result) {
+  ReleaseView();
   DB::Status s = kOK;
   MDB_txn *txn;
   MDB_val key_slice, val_slice;
@@ -206,18 +156,43 @@ DB::Status LmdbDB::Read(const std::string &table, const std::string &key, const
   } else if (ret) {
     throw utils::Exception(std::string("Read mdb_get: ") + mdb_strerror(ret));
   }
-  if (fields != nullptr) {
-    DeserializeRowFilter(&result, static_cast<char *>(val_slice.mv_data), val_slice.mv_size, *fields);
-  } else {
-    DeserializeRow(&result, static_cast<char *>(val_slice.mv_data), val_slice.mv_size);
-  }
+  codec_.Deserialize(result, static_cast<char *>(val_slice.mv_data), val_slice.mv_size, fields);
 cleanup:
   mdb_txn_abort(txn);
   return s;
 }
 
+DB::Status LmdbDB::ReadView(const std::string &table, const std::string &key,
+                            const std::vector<std::string> *fields, std::vector<FieldView> &result) {
+  // a thread can only hold one read transaction, so the previous one goes first
+  ReleaseView();
+  result.clear();
+  MDB_val key_slice, val_slice;
+
+  key_slice.mv_data = static_cast<void *>(const_cast<char *>(key.data()));
+  key_slice.mv_size = key.size();
+
+  int ret;
+  ret = mdb_txn_begin(env_, nullptr, MDB_RDONLY, &view_txn_);
+  if (ret) {
+    view_txn_ = nullptr;
+    throw utils::Exception(std::string("ReadView mdb_txn_begin: ") + mdb_strerror(ret));
+  }
+  ret = mdb_get(view_txn_, dbi_, &key_slice, &val_slice);
+  if (ret == MDB_NOTFOUND) {
+    ReleaseView();
+    return kNotFound;
+  } else if (ret) {
+    throw utils::Exception(std::string("ReadView mdb_get: ") + mdb_strerror(ret));
+  }
+  // the pages stay mapped and unchanged while view_txn_ is open
+  codec_.DeserializeView(result, static_cast<char *>(val_slice.mv_data), val_slice.mv_size, fields);
+  return kOK;
+}
+
 DB::Status LmdbDB::Scan(const std::string &table, const std::string &key, int len,
                         const std::vector<std::string> *fields, std::vector<std::vector<Field>> &result) {
+  ReleaseView();
   DB::Status s = kOK;
   MDB_txn *txn;
   MDB_cursor *cursor;
@@ -245,10 +220,48 @@ DB::Status LmdbDB::Scan(const std::string &table, const std::string &key, int le
   for (int i = 0; !ret && i < len; i++) {
     result.push_back(std::vector<Field>());
     std::vector<Field> &values = result.back();
-    if (fields != nullptr) {
-      DeserializeRowFilter(&values, static_cast<char *>(val_slice.mv_data), val_slice.mv_size, *fields);
-    } else {
-      DeserializeRow(&values, static_cast<char *>(val_slice.mv_data), val_slice.mv_size);
+    codec_.Deserialize(values, static_cast<char *>(val_slice.mv_data), val_slice.mv_size, fields);
+    ret = mdb_cursor_get(cursor, &key_slice, &val_slice, MDB_NEXT);
+  }
+cleanup:
+  mdb_cursor_close(cursor);
+  mdb_txn_abort(txn);
+  return s;
+}
+
+DB::Status LmdbDB::ScanVisit(const std::string &table, const std::string &key, int len,
+                             const std::vector<std::string> *fields, const ScanVisitor &visitor) {
+  ReleaseView();
+  DB::Status s = kOK;
+  MDB_txn *txn;
+  MDB_cursor *cursor;
+  MDB_val key_slice, val_slice;
+
+  key_slice.mv_data = static_cast<void *>(const_cast<char *>(key.data()));
+  key_slice.mv_size = key.size();
+
+  int ret;
+  ret = mdb_txn_begin(env_, nullptr, MDB_RDONLY, &txn);
+  if (ret) {
+    throw utils::Exception(std::string("ScanVisit mdb_txn_begin: ") + mdb_strerror(ret));
+  }
+  ret = mdb_cursor_open(txn, dbi_, &cursor);
+  if (ret) {
+    throw utils::Exception(std::string("ScanVisit mdb_cursor_open: ") + mdb_strerror(ret));
+  }
+  ret = mdb_cursor_get(cursor, &key_slice, &val_slice, MDB_SET);
+  if (ret == MDB_NOTFOUND) {
+    s = kNotFound;
+    goto cleanup;
+  } else if (ret) {
+    throw utils::Exception(std::string("ScanVisit mdb_cursor_get: ") + mdb_strerror(ret));
+  }
+  for (int i = 0; !ret && i < len; i++) {
+    // values point into the map and stay valid until the transaction ends
+    scan_row_.clear();
+    codec_.DeserializeView(scan_row_, static_cast<char *>(val_slice.mv_data), val_slice.mv_size, fields);
+    if (!visitor(scan_row_)) {
+      break;
     }
     ret = mdb_cursor_get(cursor, &key_slice, &val_slice, MDB_NEXT);
   }
@@ -259,6 +272,7 @@ cleanup:
 }
 
 DB::Status LmdbDB::Update(const std::string &table, const std::string &key, std::vector<Field> &values) {
+  ReleaseView();
   MDB_txn *txn;
   MDB_val key_slice, val_slice;
 
@@ -274,22 +288,10 @@ DB::Status LmdbDB::Update(const std::string &table, const std::string &key, std:
   if (ret) {
     throw utils::Exception(std::string("Update mdb_get: ") + mdb_strerror(ret));
   }
-  std::vector<Field> current_values;
-  DeserializeRow(&current_values, static_cast<char *>(val_slice.mv_data), val_slice.mv_size);
-  for (Field &new_field : values) {
-    bool found MAYBE_UNUSED = false;
-    for (Field &cur_field : current_values) {
-      if (cur_field.name == new_field.name) {
-        found = true;
-        cur_field.value = new_field.value;
-        break;
-      }
-    }
-    assert(found);
-  }
+  // patches the changed fields into a copy of the fetched row
+  std::string data(static_cast<char *>(val_slice.mv_data), val_slice.mv_size);
+  codec_.Update(data, values);
 
-  std::string data;
-  SerializeRow(current_values, &data);
   val_slice.mv_data = const_cast<char *>(data.data());
   val_slice.mv_size = data.size();
   ret = mdb_put(txn, dbi_, &key_slice, &val_slice, 0);
@@ -305,6 +307,7 @@ DB::Status LmdbDB::Update(const std::string &table, const std::string &key, std:
 }
 
 DB::Status LmdbDB::Insert(const std::string &table, const std::string &key, std::vector<Field> &values) {
+  ReleaseView();
   MDB_txn *txn;
   MDB_val key_slice, val_slice;
 
@@ -312,7 +315,7 @@ DB::Status LmdbDB::Insert(const std::string &table, const std::string &key, std:
   key_slice.mv_size = key.size();
 
   std::string data;
-  SerializeRow(values, &data);
+  codec_.Serialize(values, data);
   val_slice.mv_data = static_cast<void *>(const_cast<char *>(data.data()));
   val_slice.mv_size = data.size();
 
@@ -333,6 +336,7 @@ DB::Status LmdbDB::Insert(const std::string &table, const std::string &key, std:
 }
 
 DB::Status LmdbDB::Delete(const std::string &table, const std::string &key) {
+  ReleaseView();
   MDB_txn *txn;
   MDB_val key_slice;
 
@@ -355,6 +359,93 @@ DB::Status LmdbDB::Delete(const std::string &table, const std::string &key) {
   return kOK;
 }
 
+DB::Status LmdbDB::BatchRead(const std::string &table, const std::vector<std::string> &keys,
+                             const std::vector<std::string> *fields,
+                             std::vector<std::vector<Field>> &results, std::vector<Status> &statuses) {
+  ReleaseView();
+  DB::Status s = kOK;
+  MDB_txn *txn;
+  MDB_val key_slice, val_slice;
+
+  int ret;
+  ret = mdb_txn_begin(env_, nullptr, MDB_RDONLY, &txn);
+  if (ret) {
+    throw utils::Exception(std::string("BatchRead mdb_txn_begin: ") + mdb_strerror(ret));
+  }
+  results.clear();
+  results.resize(keys.size());
+  statuses.assign(keys.size(), kOK);
+  for (size_t i = 0; i < keys.size(); i++) {
+    key_slice.mv_data = static_cast<void *>(const_cast<char *>(keys[i].data()));
+    key_slice.mv_size = keys[i].size();
+    ret = mdb_get(txn, dbi_, &key_slice, &val_slice);
+    if (ret == MDB_NOTFOUND) {
+      s = statuses[i] = kNotFound;
+      continue;
+    } else if (ret) {
+      mdb_txn_abort(txn);
+      throw utils::Exception(std::string("BatchRead mdb_get: ") + mdb_strerror(ret));
+    }
+    codec_.Deserialize(results[i], static_cast<char *>(val_slice.mv_data), val_slice.mv_size, fields);
+  }
+  mdb_txn_abort(txn);
+  return s;
+}
+
+DB::Status LmdbDB::BatchWrite(const std::string &table, const std::vector<std::string> &keys,
+                              std::vector<std::vector<Field>> &values) {
+  ReleaseView();
+  MDB_txn *txn;
+  MDB_val key_slice, val_slice;
+
+  int ret;
+  ret = mdb_txn_begin(env_, nullptr, 0, &txn);
+  if (ret) {
+    throw utils::Exception(std::string("BatchWrite mdb_txn_begin: ") + mdb_strerror(ret));
+  }
+  std::string data;
+  for (size_t i = 0; i < keys.size(); i++) {
+    key_slice.mv_data = static_cast<void *>(const_cast<char *>(keys[i].data()));
+    key_slice.mv_size = keys[i].size();
+    data.clear();
+    codec_.Serialize(values[i], data);
+    val_slice.mv_data = static_cast<void *>(const_cast<char *>(data.data()));
+    val_slice.mv_size = data.size();
+    ret = mdb_put(txn, dbi_, &key_slice, &val_slice, 0);
+    if (ret) {
+      mdb_txn_abort(txn);
+      throw utils::Exception(std::string("BatchWrite mdb_put: ") + mdb_strerror(ret));
+    }
+  }
+  ret = mdb_txn_commit(txn);
+  if (ret) {
+    throw utils::Exception(std::string("BatchWrite mdb_txn_commit: ") + mdb_strerror(ret));
+  }
+  return kOK;
+}
+
+void LmdbDB::SampleEngineStats(EngineStats &stats) {
+  // the lock keeps the last client from closing the environment underneath
+  const std::lock_guard<std::mutex> lock(mutex_);
+  if (ref_cnt_ == 0) {
+    return;
+  }
+  MDB_stat stat;
+  MDB_envinfo info;
+  if (mdb_env_stat(env_, &stat) || mdb_env_info(env_, &info)) {
+    return;
+  }
+  stats.emplace_back("lmdb.entries", stat.ms_entries);
+  stats.emplace_back("lmdb.depth", stat.ms_depth);
+  stats.emplace_back("lmdb.leaf_pages", stat.ms_leaf_pages);
+  stats.emplace_back("lmdb.overflow_pages", stat.ms_overflow_pages);
+  stats.emplace_back("lmdb.map_size", info.me_mapsize);
+  // pages up to the last one written, free pages included
+  stats.emplace_back("lmdb.map_used", (info.me_last_pgno + 1) * stat.ms_psize);
+  stats.emplace_back("lmdb.readers", info.me_numreaders);
+  stats.emplace_back("lmdb.last_txnid", info.me_last_txnid);
+}
+
 DB *NewLmdbDB() {
   return new LmdbDB;
 }
@@ -12,6 +12,7 @@
 #include <mutex>
 
 #include "core/db.h"
+#include "core/row_codec.h"
 
 #include <lmdb.h>
 
@@ -29,23 +30,38 @@ class LmdbDB : public DB {
   Status Read(const std::string &table, const std::string &key,
               const std::vector<std::string> *fields, std::vector<Field> &result);
 
+  Status ReadView(const std::string &table, const std::string &key,
+                  const std::vector<std::string> *fields, std::vector<FieldView> &result);
+
   Status Scan(const std::string &table, const std::string &key, int len,
               const std::vector<std::string> *fields, std::vector<std::vector<Field>> &result);
 
+  Status ScanVisit(const std::string &table, const std::string &key, int len,
+                   const std::vector<std::string> *fields, const ScanVisitor &visitor);
+
   Status Update(const std::string &table, const std::string &key, std::vector<Field> &values);
 
   Status Insert(const std::string &table, const std::string &key, std::vector<Field> &values);
 
   Status Delete(const std::string &table, const std::string &key);
 
+  Status BatchRead(const std::string &table, const std::vector<std::string> &keys,
+                   const std::vector<std::string> *fields,
+                   std::vector<std::vector<Field>> &results, std::vector<Status> &statuses);
+
+  Status BatchWrite(const std::string &table, const std::vector<std::string> &keys,
+                    std::vector<std::vector<Field>> &values);
+
+  void SampleEngineStats(EngineStats &stats);
+
  private:
-  void SerializeRow(const std::vector<Field> &values, std::string *data);
-  void DeserializeRowFilter(std::vector<Field> *values, const char *data_ptr, size_t data_len,
-                            const std::vector<std::string> &fields);
-  void DeserializeRow(std::vector<Field> *values, const char *data_ptr, size_t data_len);
+  // ends the read transaction keeping the last ReadView result mapped
+  void ReleaseView();
+
+  // read-only transaction backing the views of the last ReadView, if any
+  MDB_txn *view_txn_ = nullptr;
 
-  static size_t field_count_;
-  static std::string field_prefix_;
+  RowCodec codec_;
 
   static MDB_env *env_;
   static MDB_dbi dbi_;
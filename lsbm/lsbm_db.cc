@@ -88,6 +88,7 @@ void LeveldbDB::Init() {
                                             CoreWorkload::FIELD_COUNT_DEFAULT));
   field_prefix_ = props.GetProperty(CoreWorkload::FIELD_NAME_PREFIX,
                                     CoreWorkload::FIELD_NAME_PREFIX_DEFAULT);
+  codec_.Init(props);
 
   ref_cnt_++;
   if (db_) {
@@ -170,59 +171,6 @@ void LeveldbDB::GetOptions(const utils::Properties &props, leveldb::Options *opt
   }
 }
 
-void LeveldbDB::SerializeRow(const std::vector<Field> &values, std::string *data) {
-  for (const Field &field : values) {
-    uint32_t len = field.name.size();
-    data->append(reinterpret_cast<char *>(&len), sizeof(uint32_t));
-    data->append(field.name.data(), field.name.size());
-    len = field.value.size();
-    data->append(reinterpret_cast<char *>(&len), sizeof(uint32_t));
-    data->append(field.value.data(), field.value.size());
-  }
-}
-
-void LeveldbDB::DeserializeRowFilter(std::vector<Field> *values, const std::string &data,
-                                     const std::vector<std::string> &fields) {
-  const char *p = data.data();
-  const char *lim = p + data.size();
-
-  std::vector<std::string>::const_iterator filter_iter = fields.begin();
-  while (p != lim && filter_iter != fields.end()) {
-    assert(p < lim);
-    uint32_t len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string field(p, static_cast<const size_t>(len));
-    p += len;
-    len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string value(p, static_cast<const size_t>(len));
-    p += len;
-    if (*filter_iter == field) {
-      values->push_back({field, value});
-      filter_iter++;
-    }
-  }
-  assert(values->size() == fields.size());
-}
-
-void LeveldbDB::DeserializeRow(std::vector<Field> *values, const std::string &data) {
-  const char *p = data.data();
-  const char *lim = p + data.size();
-  while (p != lim) {
-    assert(p < lim);
-    uint32_t len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string field(p, static_cast<const size_t>(len));
-    p += len;
-    len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string value(p, static_cast<const size_t>(len));
-    p += len;
-    values->push_back({field, value});
-  }
-  assert(values->size() == fieldcount_);
-}
-
 std::string LeveldbDB::BuildCompKey(const std::string &key, const std::string &field_name) {
   switch (format_) {
     case kRowMajor:
@@ -258,11 +206,7 @@ DB::Status LeveldbDB::ReadSingleEntry(const std::string &table, const std::strin
   } else if (!s.ok()) {
     throw utils::Exception(std::string("LevelDB Get: ") + s.ToString());
   }
-  // if (fields != nullptr) {
-  //   DeserializeRowFilter(&result, data, *fields);
-  // } else {
-  //   DeserializeRow(&result, data);
-  // }
+  // codec_.Deserialize(result, data, fields);
   return kOK;
 }
 
@@ -275,11 +219,7 @@ DB::Status LeveldbDB::ScanSingleEntry(const std::string &table, const std::strin
     std::string data = db_iter->value().ToString();
     result.push_back(std::vector<Field>());
     // std::vector<Field> &values = result.back();
-    // if (fields != nullptr) {
-    //   DeserializeRowFilter(&values, data, *fields);
-    // } else {
-    //   DeserializeRow(&values, data);
-    // }
+    // codec_.Deserialize(values, data, fields);
     db_iter->Next();
   }
   delete db_iter;
@@ -300,23 +240,10 @@ DB::Status LeveldbDB::UpdateSingleEntry(const std::string &table, const std::str
   } else if (!s.ok()) {
     throw utils::Exception(std::string("LevelDB Get: ") + s.ToString());
   }
-  std::vector<Field> current_values;
-  DeserializeRow(&current_values, data);
-  for (Field &new_field : values) {
-    bool found MAYBE_UNUSED = false;
-    for (Field &cur_field : current_values) {
-      if (cur_field.name == new_field.name) {
-        found = true;
-        cur_field.value = new_field.value;
-        break;
-      }
-    }
-    assert(found);
-  }
+  // patches the changed fields into the fetched row
+  codec_.Update(data, values);
   leveldb::WriteOptions wopt;
 
-  data.clear();
-  SerializeRow(current_values, &data);
   s = db_->Put(wopt, key, data);
   if (!s.ok()) {
     throw utils::Exception(std::string("LevelDB Put: ") + s.ToString());
@@ -333,7 +260,7 @@ DB::Status LeveldbDB::UpdateAllFieldsSingle(const std::string &table, const std:
 
   std::string data;
   leveldb::WriteOptions wopt;
-  SerializeRow(values, &data);
+  codec_.Serialize(values, data);
   leveldb::Status s = db_->Put(wopt, key, data);
   if (!s.ok()) {
     throw utils::Exception(std::string("LevelDB Put: ") + s.ToString());
@@ -344,7 +271,7 @@ DB::Status LeveldbDB::UpdateAllFieldsSingle(const std::string &table, const std:
 DB::Status LeveldbDB::InsertSingleEntry(const std::string &table, const std::string &key,
                                         std::vector<Field> &values) {
   std::string data;
-  SerializeRow(values, &data);
+  codec_.Serialize(values, data);
   leveldb::WriteOptions wopt;
   leveldb::Status s = db_->Put(wopt, key, data);
   if (!s.ok()) {
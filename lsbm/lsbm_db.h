@@ -13,6 +13,7 @@
 #include <mutex>
 
 #include "core/db.h"
+#include "core/row_codec.h"
 #include "utils/properties.h"
 
 #include <leveldb/db.h>
@@ -63,10 +64,6 @@ class LeveldbDB : public DB {
   LdbFormat format_;
 
   void GetOptions(const utils::Properties &props, leveldb::Options *opt);
-  void SerializeRow(const std::vector<Field> &values, std::string *data);
-  void DeserializeRowFilter(std::vector<Field> *values, const std::string &data,
-                            const std::vector<std::string> &fields);
-  void DeserializeRow(std::vector<Field> *values, const std::string &data);
   std::string BuildCompKey(const std::string &key, const std::string &field_name);
   std::string KeyFromCompKey(const std::string &comp_key);
   std::string FieldFromCompKey(const std::string &comp_key);
@@ -110,6 +107,7 @@ class LeveldbDB : public DB {
   Status (LeveldbDB::*method_delete_)(const std::string &, const std::string &);
 
   int fieldcount_;
+  RowCodec codec_;
   std::string field_prefix_;
 
   static leveldb::DB *db_;
@@ -7,14 +7,19 @@
 //
 
 #include "rocksdb_db.h"
+#include "ycsb_merge_operator.h"
+
+#include <cstdio>
 
 #include "core/core_workload.h"
 #include "core/db_factory.h"
+#include "utils/affinity.h"
 #include "utils/utils.h"
 
 #include <rocksdb/cache.h>
 #include <rocksdb/filter_policy.h>
-#include <rocksdb/merge_operator.h>
+#include <rocksdb/iostats_context.h>
+#include <rocksdb/perf_context.h>
 #include <rocksdb/status.h>
 #include <rocksdb/utilities/options_util.h>
 #include <rocksdb/write_batch.h>
@@ -29,6 +34,12 @@ namespace {
   const std::string PROP_MERGEUPDATE = "rocksdb.mergeupdate";
   const std::string PROP_MERGEUPDATE_DEFAULT = "false";
 
+  const std::string PROP_ASYNC_IO = "rocksdb.async_io";
+  const std::string PROP_ASYNC_IO_DEFAULT = "false";
+
+  const std::string PROP_BG_CPU_AFFINITY = "rocksdb.bg_cpu_affinity";
+  const std::string PROP_BG_CPU_AFFINITY_DEFAULT = "";
+
   const std::string PROP_DESTROY = "rocksdb.destroy";
   const std::string PROP_DESTROY_DEFAULT = "false";
 
@@ -104,6 +115,22 @@ namespace {
   const std::string PROP_FS_URI = "rocksdb.fs_uri";
   const std::string PROP_FS_URI_DEFAULT = "";
 
+  const std::string PROP_PERF_CONTEXT = "rocksdb.perf_context";
+  const std::string PROP_PERF_CONTEXT_DEFAULT = "false";
+
+  // sampled by the status thread, see RocksdbDB::SampleEngineStats
+  const std::vector<std::string> kEngineProperties = {
+    "rocksdb.cur-size-all-mem-tables",
+    "rocksdb.num-immutable-mem-table",
+    "rocksdb.estimate-pending-compaction-bytes",
+    "rocksdb.num-running-compactions",
+    "rocksdb.num-running-flushes",
+    "rocksdb.actual-delayed-write-rate",
+    "rocksdb.is-write-stopped",
+    "rocksdb.block-cache-usage",
+    "rocksdb.block-cache-pinned-usage",
+  };
+
   static std::shared_ptr<rocksdb::Env> env_guard;
   static std::shared_ptr<rocksdb::Cache> block_cache;
 #if ROCKSDB_MAJOR < 8
@@ -117,50 +144,9 @@ std::vector<rocksdb::ColumnFamilyHandle *> RocksdbDB::cf_handles_;
 rocksdb::DB *RocksdbDB::db_ = nullptr;
 int RocksdbDB::ref_cnt_ = 0;
 std::mutex RocksdbDB::mu_;
+std::atomic<int> RocksdbDB::sst_file_id_(0);
 
 void RocksdbDB::Init() {
-// merge operator disabled by default due to link error
-#ifdef USE_MERGEUPDATE
-  class YCSBUpdateMerge : public rocksdb::AssociativeMergeOperator {
-   public:
-    virtual bool Merge(const rocksdb::Slice &key, const rocksdb::Slice *existing_value,
-                       const rocksdb::Slice &value, std::string *new_value,
-                       rocksdb::Logger *logger) const override {
-      assert(existing_value);
-
-      std::vector<Field> values;
-      const char *p = existing_value->data();
-      const char *lim = p + existing_value->size();
-      DeserializeRow(values, p, lim);
-
-      std::vector<Field> new_values;
-      p = value.data();
-      lim = p + value.size();
-      DeserializeRow(new_values, p, lim);
-
-      for (Field &new_field : new_values) {
-        bool found = false;
-        for (Field &field : values) {
-          if (field.name == new_field.name) {
-            found = true;
-            field.value = new_field.value;
-            break;
-          }
-        }
-        if (!found) {
-          values.push_back(new_field);
-        }
-      }
-
-      SerializeRow(values, *new_value);
-      return true;
-    }
-
-    virtual const char *Name() const override {
-      return "YCSBUpdateMerge";
-    }
-  };
-#endif
   const std::lock_guard<std::mutex> lock(mu_);
 
   const utils::Properties &props = *props_;
@@ -168,20 +154,25 @@ void RocksdbDB::Init() {
   if (format == "single") {
     format_ = kSingleRow;
     method_read_ = &RocksdbDB::ReadSingle;
+    method_read_view_ = &RocksdbDB::ReadViewSingle;
     method_scan_ = &RocksdbDB::ScanSingle;
+    method_scan_visit_ = &RocksdbDB::ScanVisitSingle;
     method_update_ = &RocksdbDB::UpdateSingle;
     method_insert_ = &RocksdbDB::InsertSingle;
     method_delete_ = &RocksdbDB::DeleteSingle;
-#ifdef USE_MERGEUPDATE
+    method_batch_read_ = &RocksdbDB::BatchReadSingle;
+    method_batch_write_ = &RocksdbDB::BatchWriteSingle;
     if (props.GetProperty(PROP_MERGEUPDATE, PROP_MERGEUPDATE_DEFAULT) == "true") {
       method_update_ = &RocksdbDB::MergeSingle;
     }
-#endif
   } else {
     throw utils::Exception("unknown format");
   }
   fieldcount_ = std::stoi(props.GetProperty(CoreWorkload::FIELD_COUNT_PROPERTY,
                                             CoreWorkload::FIELD_COUNT_DEFAULT));
+  codec_.Init(props);
+  perf_context_ = props.GetProperty(PROP_PERF_CONTEXT, PROP_PERF_CONTEXT_DEFAULT) == "true";
+  batch_read_options_.async_io = props.GetProperty(PROP_ASYNC_IO, PROP_ASYNC_IO_DEFAULT) == "true";
 
   ref_cnt_++;
   if (db_) {
@@ -197,9 +188,13 @@ void RocksdbDB::Init() {
   opt.create_if_missing = true;
   std::vector<rocksdb::ColumnFamilyDescriptor> cf_descs;
   GetOptions(props, &opt, &cf_descs);
-#ifdef USE_MERGEUPDATE
-  opt.merge_operator.reset(new YCSBUpdateMerge);
-#endif
+  // always installed, so a db loaded with mergeupdate=true stays readable without it
+  opt.merge_operator = NewYCSBUpdateMerge(codec_);
+
+  // background threads are started while opening and inherit the affinity of
+  // this client thread; without a list they get the mask it had before cpu.affinity
+  utils::ScopedAffinity bg_affinity(utils::ParseCpuList(
+      props.GetProperty(PROP_BG_CPU_AFFINITY, PROP_BG_CPU_AFFINITY_DEFAULT)));
 
   rocksdb::Status s;
   if (props.GetProperty(PROP_DESTROY, PROP_DESTROY_DEFAULT) == "true") {
@@ -367,66 +362,6 @@ void RocksdbDB::GetOptions(const utils::Properties &props, rocksdb::Options *opt
   }
 }
 
-void RocksdbDB::SerializeRow(const std::vector<Field> &values, std::string &data) {
-  for (const Field &field : values) {
-    uint32_t len = field.name.size();
-    data.append(reinterpret_cast<char *>(&len), sizeof(uint32_t));
-    data.append(field.name.data(), field.name.size());
-    len = field.value.size();
-    data.append(reinterpret_cast<char *>(&len), sizeof(uint32_t));
-    data.append(field.value.data(), field.value.size());
-  }
-}
-
-void RocksdbDB::DeserializeRowFilter(std::vector<Field> &values, const char *p, const char *lim,
-                                     const std::vector<std::string> &fields) {
-  std::vector<std::string>::const_iterator filter_iter = fields.begin();
-  while (p != lim && filter_iter != fields.end()) {
-    assert(p < lim);
-    uint32_t len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string field(p, static_cast<const size_t>(len));
-    p += len;
-    len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string value(p, static_cast<const size_t>(len));
-    p += len;
-    if (*filter_iter == field) {
-      values.push_back({field, value});
-      filter_iter++;
-    }
-  }
-  assert(values.size() == fields.size());
-}
-
-void RocksdbDB::DeserializeRowFilter(std::vector<Field> &values, const std::string &data,
-                                     const std::vector<std::string> &fields) {
-  const char *p = data.data();
-  const char *lim = p + data.size();
-  DeserializeRowFilter(values, p, lim, fields);
-}
-
-void RocksdbDB::DeserializeRow(std::vector<Field> &values, const char *p, const char *lim) {
-  while (p != lim) {
-    assert(p < lim);
-    uint32_t len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string field(p, static_cast<const size_t>(len));
-    p += len;
-    len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string value(p, static_cast<const size_t>(len));
-    p += len;
-    values.push_back({field, value});
-  }
-}
-
-void RocksdbDB::DeserializeRow(std::vector<Field> &values, const std::string &data) {
-  const char *p = data.data();
-  const char *lim = p + data.size();
-  DeserializeRow(values, p, lim);
-}
-
 DB::Status RocksdbDB::ReadSingle(const std::string &table, const std::string &key,
                                  const std::vector<std::string> *fields,
                                  std::vector<Field> &result) {
@@ -437,12 +372,25 @@ DB::Status RocksdbDB::ReadSingle(const std::string &table, const std::string &ke
   } else if (!s.ok()) {
     throw utils::Exception(std::string("RocksDB Get: ") + s.ToString());
   }
-  if (fields != nullptr) {
-    DeserializeRowFilter(result, data, *fields);
-  } else {
-    DeserializeRow(result, data);
-    assert(result.size() == static_cast<size_t>(fieldcount_));
+  codec_.Deserialize(result, data, fields);
+  assert(fields != nullptr || result.size() == static_cast<size_t>(fieldcount_));
+  return kOK;
+}
+
+DB::Status RocksdbDB::ReadViewSingle(const std::string &table, const std::string &key,
+                                     const std::vector<std::string> *fields,
+                                     std::vector<FieldView> &result) {
+  result.clear();
+  // releases the block pinned by the previous read
+  pinned_value_.Reset();
+  rocksdb::Status s = db_->Get(rocksdb::ReadOptions(), db_->DefaultColumnFamily(), key, &pinned_value_);
+  if (s.IsNotFound()) {
+    return kNotFound;
+  } else if (!s.ok()) {
+    throw utils::Exception(std::string("RocksDB Get: ") + s.ToString());
   }
+  codec_.DeserializeView(result, pinned_value_.data(), pinned_value_.size(), fields);
+  assert(fields != nullptr || result.size() == static_cast<size_t>(fieldcount_));
   return kOK;
 }
 
@@ -455,11 +403,27 @@ DB::Status RocksdbDB::ScanSingle(const std::string &table, const std::string &ke
     std::string data = db_iter->value().ToString();
     result.push_back(std::vector<Field>());
     std::vector<Field> &values = result.back();
-    if (fields != nullptr) {
-      DeserializeRowFilter(values, data, *fields);
-    } else {
-      DeserializeRow(values, data);
-      assert(values.size() == static_cast<size_t>(fieldcount_));
+    codec_.Deserialize(values, data, fields);
+    assert(fields != nullptr || values.size() == static_cast<size_t>(fieldcount_));
+    db_iter->Next();
+  }
+  delete db_iter;
+  return kOK;
+}
+
+DB::Status RocksdbDB::ScanVisitSingle(const std::string &table, const std::string &key, int len,
+                                      const std::vector<std::string> *fields,
+                                      const ScanVisitor &visitor) {
+  rocksdb::Iterator *db_iter = db_->NewIterator(rocksdb::ReadOptions());
+  db_iter->Seek(key);
+  for (int i = 0; db_iter->Valid() && i < len; i++) {
+    // the value slice stays valid until the iterator moves
+    rocksdb::Slice data = db_iter->value();
+    scan_row_.clear();
+    codec_.DeserializeView(scan_row_, data.data(), data.size(), fields);
+    assert(fields != nullptr || scan_row_.size() == static_cast<size_t>(fieldcount_));
+    if (!visitor(scan_row_)) {
+      break;
     }
     db_iter->Next();
   }
@@ -476,24 +440,10 @@ DB::Status RocksdbDB::UpdateSingle(const std::string &table, const std::string &
   } else if (!s.ok()) {
     throw utils::Exception(std::string("RocksDB Get: ") + s.ToString());
   }
-  std::vector<Field> current_values;
-  DeserializeRow(current_values, data);
-  assert(current_values.size() == static_cast<size_t>(fieldcount_));
-  for (Field &new_field : values) {
-    bool found MAYBE_UNUSED = false;
-    for (Field &cur_field : current_values) {
-      if (cur_field.name == new_field.name) {
-        found = true;
-        cur_field.value = new_field.value;
-        break;
-      }
-    }
-    assert(found);
-  }
+  // patches the changed fields into the fetched row
+  codec_.Update(data, values);
   rocksdb::WriteOptions wopt;
 
-  data.clear();
-  SerializeRow(current_values, data);
   s = db_->Put(wopt, key, data);
   if (!s.ok()) {
     throw utils::Exception(std::string("RocksDB Put: ") + s.ToString());
@@ -504,7 +454,7 @@ DB::Status RocksdbDB::UpdateSingle(const std::string &table, const std::string &
 DB::Status RocksdbDB::MergeSingle(const std::string &table, const std::string &key,
                                   std::vector<Field> &values) {
   std::string data;
-  SerializeRow(values, data);
+  codec_.Serialize(values, data);
   rocksdb::WriteOptions wopt;
   rocksdb::Status s = db_->Merge(wopt, key, data);
   if (!s.ok()) {
@@ -516,7 +466,7 @@ DB::Status RocksdbDB::MergeSingle(const std::string &table, const std::string &k
 DB::Status RocksdbDB::InsertSingle(const std::string &table, const std::string &key,
                                    std::vector<Field> &values) {
   std::string data;
-  SerializeRow(values, data);
+  codec_.Serialize(values, data);
   rocksdb::WriteOptions wopt;
   rocksdb::Status s = db_->Put(wopt, key, data);
   if (!s.ok()) {
@@ -534,6 +484,130 @@ DB::Status RocksdbDB::DeleteSingle(const std::string &table, const std::string &
   return kOK;
 }
 
+DB::Status RocksdbDB::BatchReadSingle(const std::string &table, const std::vector<std::string> &keys,
+                                      const std::vector<std::string> *fields,
+                                      std::vector<std::vector<Field>> &results,
+                                      std::vector<Status> &statuses) {
+  std::vector<rocksdb::Slice> key_slices(keys.begin(), keys.end());
+  // async_io is only honored by the batched MultiGet
+  std::vector<rocksdb::PinnableSlice> values(keys.size());
+  std::vector<rocksdb::Status> get_statuses(keys.size());
+  db_->MultiGet(batch_read_options_, db_->DefaultColumnFamily(), keys.size(), key_slices.data(),
+                values.data(), get_statuses.data());
+  results.clear();
+  results.resize(keys.size());
+  statuses.assign(keys.size(), kOK);
+  Status ret = kOK;
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (get_statuses[i].IsNotFound()) {
+      ret = statuses[i] = kNotFound;
+      continue;
+    } else if (!get_statuses[i].ok()) {
+      throw utils::Exception(std::string("RocksDB MultiGet: ") + get_statuses[i].ToString());
+    }
+    codec_.Deserialize(results[i], values[i].data(), values[i].size(), fields);
+    assert(fields != nullptr || results[i].size() == static_cast<size_t>(fieldcount_));
+  }
+  return ret;
+}
+
+DB::Status RocksdbDB::BatchWriteSingle(const std::string &table, const std::vector<std::string> &keys,
+                                       std::vector<std::vector<Field>> &values) {
+  rocksdb::WriteBatch batch;
+  std::string data;
+  for (size_t i = 0; i < keys.size(); i++) {
+    data.clear();
+    codec_.Serialize(values[i], data);
+    batch.Put(keys[i], data);
+  }
+  rocksdb::WriteOptions wopt;
+  rocksdb::Status s = db_->Write(wopt, &batch);
+  if (!s.ok()) {
+    throw utils::Exception(std::string("RocksDB Write: ") + s.ToString());
+  }
+  return kOK;
+}
+
+DB::Status RocksdbDB::BeginBulkLoad(const std::string &table) {
+  // the file is written inside the db directory and moved into the LSM on ingestion
+  const std::string &db_path = props_->GetProperty(PROP_NAME, PROP_NAME_DEFAULT);
+  sst_file_ = db_path + "/ycsb_bulkload_" + std::to_string(sst_file_id_.fetch_add(1)) + ".sst";
+  sst_entries_ = 0;
+  sst_writer_.reset(new rocksdb::SstFileWriter(rocksdb::EnvOptions(), db_->GetOptions()));
+  rocksdb::Status s = sst_writer_->Open(sst_file_);
+  if (!s.ok()) {
+    throw utils::Exception(std::string("RocksDB SstFileWriter Open: ") + s.ToString());
+  }
+  return kOK;
+}
+
+DB::Status RocksdbDB::BulkLoadPut(const std::string &table, const std::string &key,
+                                  std::vector<Field> &values) {
+  std::string data;
+  codec_.Serialize(values, data);
+  rocksdb::Status s = sst_writer_->Put(key, data);
+  if (!s.ok()) {
+    throw utils::Exception(std::string("RocksDB SstFileWriter Put: ") + s.ToString());
+  }
+  sst_entries_++;
+  return kOK;
+}
+
+DB::Status RocksdbDB::FinishBulkLoad(const std::string &table) {
+  if (sst_entries_ == 0) {
+    // an empty sst file cannot be finished, nothing to ingest
+    sst_writer_.reset();
+    std::remove(sst_file_.c_str());
+    return kOK;
+  }
+  rocksdb::Status s = sst_writer_->Finish();
+  sst_writer_.reset();
+  if (!s.ok()) {
+    throw utils::Exception(std::string("RocksDB SstFileWriter Finish: ") + s.ToString());
+  }
+  rocksdb::IngestExternalFileOptions ingest_opt;
+  ingest_opt.move_files = true;
+  s = db_->IngestExternalFile({sst_file_}, ingest_opt);
+  if (!s.ok()) {
+    throw utils::Exception(std::string("RocksDB IngestExternalFile: ") + s.ToString());
+  }
+  return kOK;
+}
+
+void RocksdbDB::StartCounters() {
+  // the perf level is per thread, and client threads may not have run Init
+  rocksdb::SetPerfLevel(rocksdb::PerfLevel::kEnableCount);
+  rocksdb::get_perf_context()->Reset();
+  rocksdb::get_iostats_context()->Reset();
+}
+
+void RocksdbDB::ReadCounters(EngineCounters &counters) {
+  const rocksdb::PerfContext &perf = *rocksdb::get_perf_context();
+  counters.value[BLOCK_CACHE_HIT] = perf.block_cache_hit_count;
+  counters.value[BLOCK_READ] = perf.block_read_count;
+  counters.value[BLOCK_READ_BYTES] = perf.block_read_byte;
+  counters.value[BYTES_READ] = rocksdb::get_iostats_context()->bytes_read;
+  counters.value[MEMTABLE_GET] = perf.get_from_memtable_count;
+  counters.value[SST_OP] = perf.block_cache_hit_count + perf.block_read_count > 0;
+  counters.value[SEEK] = perf.iter_seek_count;
+  counters.value[NEXT] = perf.iter_next_count;
+  counters.value[KEY_SKIPPED] = perf.internal_key_skipped_count;
+}
+
+void RocksdbDB::SampleEngineStats(EngineStats &stats) {
+  // the lock keeps the last client from closing the db underneath
+  const std::lock_guard<std::mutex> lock(mu_);
+  if (ref_cnt_ == 0) {
+    return;
+  }
+  for (const std::string &name : kEngineProperties) {
+    uint64_t value;
+    if (db_->GetIntProperty(name, &value)) {
+      stats.emplace_back(name, value);
+    }
+  }
+}
+
 DB *NewRocksdbDB() {
   return new RocksdbDB;
 }
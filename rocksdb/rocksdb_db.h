@@ -8,20 +8,24 @@
 #ifndef YCSB_C_ROCKSDB_DB_H_
 #define YCSB_C_ROCKSDB_DB_H_
 
+#include <atomic>
+#include <memory>
 #include <string>
 #include <mutex>
 
 #include "core/db.h"
+#include "core/row_codec.h"
 #include "utils/properties.h"
 
 #include <rocksdb/db.h>
 #include <rocksdb/options.h>
+#include <rocksdb/sst_file_writer.h>
 
 namespace ycsbc {
 
 class RocksdbDB : public DB {
  public:
-  RocksdbDB() {}
+  RocksdbDB() : perf_context_(false), sst_entries_(0) {}
   ~RocksdbDB() {}
 
   void Init();
@@ -33,11 +37,21 @@ class RocksdbDB : public DB {
     return (this->*(method_read_))(table, key, fields, result);
   }
 
+  Status ReadView(const std::string &table, const std::string &key,
+                  const std::vector<std::string> *fields, std::vector<FieldView> &result) {
+    return (this->*(method_read_view_))(table, key, fields, result);
+  }
+
   Status Scan(const std::string &table, const std::string &key, int len,
               const std::vector<std::string> *fields, std::vector<std::vector<Field>> &result) {
     return (this->*(method_scan_))(table, key, len, fields, result);
   }
 
+  Status ScanVisit(const std::string &table, const std::string &key, int len,
+                   const std::vector<std::string> *fields, const ScanVisitor &visitor) {
+    return (this->*(method_scan_visit_))(table, key, len, fields, visitor);
+  }
+
   Status Update(const std::string &table, const std::string &key, std::vector<Field> &values) {
     return (this->*(method_update_))(table, key, values);
   }
@@ -50,6 +64,33 @@ class RocksdbDB : public DB {
     return (this->*(method_delete_))(table, key);
   }
 
+  Status BeginBulkLoad(const std::string &table);
+
+  Status BulkLoadPut(const std::string &table, const std::string &key, std::vector<Field> &values);
+
+  Status FinishBulkLoad(const std::string &table);
+
+  bool CollectsCounters() const {
+    return perf_context_;
+  }
+
+  void StartCounters();
+
+  void ReadCounters(EngineCounters &counters);
+
+  void SampleEngineStats(EngineStats &stats);
+
+  Status BatchRead(const std::string &table, const std::vector<std::string> &keys,
+                   const std::vector<std::string> *fields,
+                   std::vector<std::vector<Field>> &results, std::vector<Status> &statuses) {
+    return (this->*(method_batch_read_))(table, keys, fields, results, statuses);
+  }
+
+  Status BatchWrite(const std::string &table, const std::vector<std::string> &keys,
+                    std::vector<std::vector<Field>> &values) {
+    return (this->*(method_batch_write_))(table, keys, values);
+  }
+
  private:
   enum RocksFormat {
     kSingleRow,
@@ -58,19 +99,16 @@ class RocksdbDB : public DB {
 
   void GetOptions(const utils::Properties &props, rocksdb::Options *opt,
                   std::vector<rocksdb::ColumnFamilyDescriptor> *cf_descs);
-  static void SerializeRow(const std::vector<Field> &values, std::string &data);
-  static void DeserializeRowFilter(std::vector<Field> &values, const char *p, const char *lim,
-                                   const std::vector<std::string> &fields);
-  static void DeserializeRowFilter(std::vector<Field> &values, const std::string &data,
-                                   const std::vector<std::string> &fields);
-  static void DeserializeRow(std::vector<Field> &values, const char *p, const char *lim);
-  static void DeserializeRow(std::vector<Field> &values, const std::string &data);
 
   Status ReadSingle(const std::string &table, const std::string &key,
                     const std::vector<std::string> *fields, std::vector<Field> &result);
+  Status ReadViewSingle(const std::string &table, const std::string &key,
+                        const std::vector<std::string> *fields, std::vector<FieldView> &result);
   Status ScanSingle(const std::string &table, const std::string &key, int len,
                     const std::vector<std::string> *fields,
                     std::vector<std::vector<Field>> &result);
+  Status ScanVisitSingle(const std::string &table, const std::string &key, int len,
+                         const std::vector<std::string> *fields, const ScanVisitor &visitor);
   Status UpdateSingle(const std::string &table, const std::string &key,
                       std::vector<Field> &values);
   Status MergeSingle(const std::string &table, const std::string &key,
@@ -78,9 +116,19 @@ class RocksdbDB : public DB {
   Status InsertSingle(const std::string &table, const std::string &key,
                       std::vector<Field> &values);
   Status DeleteSingle(const std::string &table, const std::string &key);
+  Status BatchReadSingle(const std::string &table, const std::vector<std::string> &keys,
+                         const std::vector<std::string> *fields,
+                         std::vector<std::vector<Field>> &results, std::vector<Status> &statuses);
+  Status BatchWriteSingle(const std::string &table, const std::vector<std::string> &keys,
+                          std::vector<std::vector<Field>> &values);
 
   Status (RocksdbDB::*method_read_)(const std::string &, const std:: string &,
                                     const std::vector<std::string> *, std::vector<Field> &);
+  Status (RocksdbDB::*method_read_view_)(const std::string &, const std::string &,
+                                         const std::vector<std::string> *, std::vector<FieldView> &);
+  Status (RocksdbDB::*method_scan_visit_)(const std::string &, const std::string &,
+                                          int, const std::vector<std::string> *,
+                                          const ScanVisitor &);
   Status (RocksdbDB::*method_scan_)(const std::string &, const std::string &,
                                     int, const std::vector<std::string> *,
                                     std::vector<std::vector<Field>> &);
@@ -89,13 +137,30 @@ class RocksdbDB : public DB {
   Status (RocksdbDB::*method_insert_)(const std::string &, const std::string &,
                                       std::vector<Field> &);
   Status (RocksdbDB::*method_delete_)(const std::string &, const std::string &);
+  Status (RocksdbDB::*method_batch_read_)(const std::string &, const std::vector<std::string> &,
+                                          const std::vector<std::string> *,
+                                          std::vector<std::vector<Field>> &, std::vector<Status> &);
+  Status (RocksdbDB::*method_batch_write_)(const std::string &, const std::vector<std::string> &,
+                                           std::vector<std::vector<Field>> &);
 
   int fieldcount_;
+  RowCodec codec_;
+  // async_io lets MultiGet overlap the block reads of a batch
+  rocksdb::ReadOptions batch_read_options_;
+  // holds the value behind the views of the last ReadView
+  rocksdb::PinnableSlice pinned_value_;
+  // break operations down with the thread's PerfContext and IOStatsContext
+  bool perf_context_;
 
   static std::vector<rocksdb::ColumnFamilyHandle *> cf_handles_;
   static rocksdb::DB *db_;
   static int ref_cnt_;
   static std::mutex mu_;
+
+  std::unique_ptr<rocksdb::SstFileWriter> sst_writer_;
+  std::string sst_file_;
+  uint64_t sst_entries_;
+  static std::atomic<int> sst_file_id_;
 };
 
 DB *NewRocksdbDB();
@@ -0,0 +1,47 @@
+//
+//  ycsb_merge_operator.cc
+//  YCSB-cpp
+//
+
+#include "ycsb_merge_operator.h"
+
+#include "utils/utils.h"
+
+namespace {
+  class YCSBUpdateMerge : public rocksdb::AssociativeMergeOperator {
+   public:
+    explicit YCSBUpdateMerge(const ycsbc::RowCodec &codec) : codec_(codec) {}
+
+    bool Merge(const rocksdb::Slice &key, const rocksdb::Slice *existing_value,
+               const rocksdb::Slice &value, std::string *new_value,
+               rocksdb::Logger *logger) const override {
+      if (existing_value == nullptr) {
+        new_value->assign(value.data(), value.size());
+        return true;
+      }
+      new_value->assign(existing_value->data(), existing_value->size());
+      try {
+        codec_.Merge(*new_value, value.data(), value.size());
+      } catch (const ycsbc::utils::Exception &) {
+        // reported by RocksDB as a corruption of the merged key
+        return false;
+      }
+      return true;
+    }
+
+    const char *Name() const override {
+      return "YCSBUpdateMerge";
+    }
+
+   private:
+    ycsbc::RowCodec codec_;
+  };
+} // anonymous
+
+namespace ycsbc {
+
+std::shared_ptr<rocksdb::MergeOperator> NewYCSBUpdateMerge(const RowCodec &codec) {
+  return std::make_shared<YCSBUpdateMerge>(codec);
+}
+
+} // ycsbc
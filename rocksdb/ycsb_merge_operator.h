@@ -0,0 +1,30 @@
+//
+//  ycsb_merge_operator.h
+//  YCSB-cpp
+//
+
+#ifndef YCSB_C_YCSB_MERGE_OPERATOR_H_
+#define YCSB_C_YCSB_MERGE_OPERATOR_H_
+
+#include <memory>
+
+#include "core/row_codec.h"
+
+#include <rocksdb/merge_operator.h>
+
+namespace ycsbc {
+
+///
+/// Returns the merge operator behind rocksdb.mergeupdate. Each operand is an
+/// encoded partial row whose fields overwrite those of the stored row, so a
+/// field update becomes a blind Merge instead of Get + Put.
+///
+/// The operator lives in its own translation unit, built with -fno-rtti, as
+/// subclassing a RocksDB class from code with RTTI does not link against
+/// RocksDB release builds, which are compiled without it.
+///
+std::shared_ptr<rocksdb::MergeOperator> NewYCSBUpdateMerge(const RowCodec &codec);
+
+} // ycsbc
+
+#endif // YCSB_C_YCSB_MERGE_OPERATOR_H_
@@ -8,13 +8,17 @@
 
 #include "rocksdb_db.h"
 
+#include <cstdio>
+
 #include "core/core_workload.h"
 #include "core/db_factory.h"
 #include "utils/utils.h"
 
 #include <rocksdb/cache.h>
 #include <rocksdb/filter_policy.h>
+#include <rocksdb/iostats_context.h>
 #include <rocksdb/merge_operator.h>
+#include <rocksdb/perf_context.h>
 #include <rocksdb/status.h>
 #include <rocksdb/utilities/options_util.h>
 #include <rocksdb/write_batch.h>
@@ -134,6 +138,22 @@ namespace {
   const std::string PROP_FS_URI = "rocksdb.fs_uri";
   const std::string PROP_FS_URI_DEFAULT = "";
 
+  const std::string PROP_PERF_CONTEXT = "rocksdb.perf_context";
+  const std::string PROP_PERF_CONTEXT_DEFAULT = "false";
+
+  // sampled by the status thread, see RocksdbDB::SampleEngineStats
+  const std::vector<std::string> kEngineProperties = {
+    "rocksdb.cur-size-all-mem-tables",
+    "rocksdb.num-immutable-mem-table",
+    "rocksdb.estimate-pending-compaction-bytes",
+    "rocksdb.num-running-compactions",
+    "rocksdb.num-running-flushes",
+    "rocksdb.actual-delayed-write-rate",
+    "rocksdb.is-write-stopped",
+    "rocksdb.block-cache-usage",
+    "rocksdb.block-cache-pinned-usage",
+  };
+
   const std::string PROP_DESERIALIZE_ON_READ = "rocksdb.deserialize_on_read";
   const std::string PROP_DESERIALIZE_ON_READ_DEFAULT = "false";
 
@@ -152,48 +172,31 @@ std::vector<rocksdb::ColumnFamilyHandle *> RocksdbDB::cf_handles_;
 rocksdb::DB *RocksdbDB::db_ = nullptr;
 int RocksdbDB::ref_cnt_ = 0;
 std::mutex RocksdbDB::mu_;
+std::atomic<int> RocksdbDB::sst_file_id_(0);
 
 void RocksdbDB::Init() {
 // merge operator disabled by default due to link error
 #ifdef USE_MERGEUPDATE
   class YCSBUpdateMerge : public rocksdb::AssociativeMergeOperator {
    public:
+    explicit YCSBUpdateMerge(const RowCodec &codec) : codec_(codec) {}
+
     virtual bool Merge(const rocksdb::Slice &key, const rocksdb::Slice *existing_value,
                        const rocksdb::Slice &value, std::string *new_value,
                        rocksdb::Logger *logger) const override {
       assert(existing_value);
 
-      std::vector<Field> values;
-      const char *p = existing_value->data();
-      const char *lim = p + existing_value->size();
-      DeserializeRow(values, p, lim);
-
-      std::vector<Field> new_values;
-      p = value.data();
-      lim = p + value.size();
-      DeserializeRow(new_values, p, lim);
-
-      for (Field &new_field : new_values) {
-        bool found = false;
-        for (Field &field : values) {
-          if (field.name == new_field.name) {
-            found = true;
-            field.value = new_field.value;
-            break;
-          }
-        }
-        if (!found) {
-          values.push_back(new_field);
-        }
-      }
-
-      SerializeRow(values, *new_value);
+      new_value->assign(existing_value->data(), existing_value->size());
+      codec_.Merge(*new_value, value.data(), value.size());
       return true;
     }
 
     virtual const char *Name() const override {
       return "YCSBUpdateMerge";
     }
+
+   private:
+    RowCodec codec_;
   };
 #endif
   const std::lock_guard<std::mutex> lock(mu_);
@@ -203,7 +206,9 @@ void RocksdbDB::Init() {
   if (format == "single") {
     format_ = kSingleRow;
     method_read_ = &RocksdbDB::ReadSingle;
+    method_read_view_ = &RocksdbDB::ReadViewSingle;
     method_scan_ = &RocksdbDB::ScanSingle;
+    method_scan_visit_ = &RocksdbDB::ScanVisitSingle;
     method_update_ = &RocksdbDB::UpdateSingle;
     method_insert_ = &RocksdbDB::InsertSingle;
     method_delete_ = &RocksdbDB::DeleteSingle;
@@ -217,6 +222,8 @@ void RocksdbDB::Init() {
   }
   fieldcount_ = std::stoi(props.GetProperty(CoreWorkload::FIELD_COUNT_PROPERTY,
                                             CoreWorkload::FIELD_COUNT_DEFAULT));
+  codec_.Init(props);
+  perf_context_ = props.GetProperty(PROP_PERF_CONTEXT, PROP_PERF_CONTEXT_DEFAULT) == "true";
   disable_wal_ = (props.GetProperty(PROP_DISABLE_WAL, PROP_DISABLE_WAL_DEFAULT) == "true");
   deserialize_on_read_ = (props.GetProperty(PROP_DESERIALIZE_ON_READ, PROP_DESERIALIZE_ON_READ_DEFAULT) == "true");
 
@@ -234,7 +241,7 @@ void RocksdbDB::Init() {
   std::vector<rocksdb::ColumnFamilyDescriptor> cf_descs;
   GetOptions(props, &opt, &cf_descs);
 #ifdef USE_MERGEUPDATE
-  opt.merge_operator.reset(new YCSBUpdateMerge);
+  opt.merge_operator.reset(new YCSBUpdateMerge(codec_));
 #endif
 
   rocksdb::Status s;
@@ -443,66 +450,6 @@ void RocksdbDB::GetOptions(const utils::Properties &props, rocksdb::Options *opt
   }
 }
 
-void RocksdbDB::SerializeRow(const std::vector<Field> &values, std::string &data) {
-  for (const Field &field : values) {
-    uint32_t len = field.name.size();
-    data.append(reinterpret_cast<char *>(&len), sizeof(uint32_t));
-    data.append(field.name.data(), field.name.size());
-    len = field.value.size();
-    data.append(reinterpret_cast<char *>(&len), sizeof(uint32_t));
-    data.append(field.value.data(), field.value.size());
-  }
-}
-
-void RocksdbDB::DeserializeRowFilter(std::vector<Field> &values, const char *p, const char *lim,
-                                     const std::vector<std::string> &fields) {
-  std::vector<std::string>::const_iterator filter_iter = fields.begin();
-  while (p != lim && filter_iter != fields.end()) {
-    assert(p < lim);
-    uint32_t len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string field(p, static_cast<const size_t>(len));
-    p += len;
-    len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string value(p, static_cast<const size_t>(len));
-    p += len;
-    if (*filter_iter == field) {
-      values.push_back({field, value});
-      filter_iter++;
-    }
-  }
-  assert(values.size() == fields.size());
-}
-
-void RocksdbDB::DeserializeRowFilter(std::vector<Field> &values, const std::string &data,
-                                     const std::vector<std::string> &fields) {
-  const char *p = data.data();
-  const char *lim = p + data.size();
-  DeserializeRowFilter(values, p, lim, fields);
-}
-
-void RocksdbDB::DeserializeRow(std::vector<Field> &values, const char *p, const char *lim) {
-  while (p != lim) {
-    assert(p < lim);
-    uint32_t len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string field(p, static_cast<const size_t>(len));
-    p += len;
-    len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string value(p, static_cast<const size_t>(len));
-    p += len;
-    values.push_back({field, value});
-  }
-}
-
-void RocksdbDB::DeserializeRow(std::vector<Field> &values, const std::string &data) {
-  const char *p = data.data();
-  const char *lim = p + data.size();
-  DeserializeRow(values, p, lim);
-}
-
 DB::Status RocksdbDB::ReadSingle(const std::string &table, const std::string &key,
                                  const std::vector<std::string> *fields,
                                  std::vector<Field> &result) {
@@ -516,17 +463,33 @@ DB::Status RocksdbDB::ReadSingle(const std::string &table, const std::string &ke
   
   // Only deserialize if enabled
   if (deserialize_on_read_) {
-    if (fields != nullptr) {
-      DeserializeRowFilter(result, data, *fields);
-    } else {
-      DeserializeRow(result, data);
-      assert(result.size() == static_cast<size_t>(fieldcount_));
-    }
+    codec_.Deserialize(result, data, fields);
+    assert(fields != nullptr || result.size() == static_cast<size_t>(fieldcount_));
   }
   
   return kOK;
 }
 
+DB::Status RocksdbDB::ReadViewSingle(const std::string &table, const std::string &key,
+                                     const std::vector<std::string> *fields,
+                                     std::vector<FieldView> &result) {
+  result.clear();
+  // releases the block pinned by the previous read
+  pinned_value_.Reset();
+  rocksdb::Status s = db_->Get(rocksdb::ReadOptions(), db_->DefaultColumnFamily(), key, &pinned_value_);
+  if (s.IsNotFound()) {
+    return kNotFound;
+  } else if (!s.ok()) {
+    throw utils::Exception(std::string("RocksDB Get: ") + s.ToString());
+  }
+  // Only deserialize if enabled
+  if (deserialize_on_read_) {
+    codec_.DeserializeView(result, pinned_value_.data(), pinned_value_.size(), fields);
+    assert(fields != nullptr || result.size() == static_cast<size_t>(fieldcount_));
+  }
+  return kOK;
+}
+
 DB::Status RocksdbDB::ScanSingle(const std::string &table, const std::string &key, int len,
                                  const std::vector<std::string> *fields,
                                  std::vector<std::vector<Field>> &result) {
@@ -542,11 +505,32 @@ DB::Status RocksdbDB::ScanSingle(const std::string &table, const std::string &ke
       std::string &data = values[i];
       result.push_back(std::vector<Field>());
       std::vector<Field> &field_value = result.back();
-      if (fields != nullptr) {
-        DeserializeRowFilter(field_value, data, *fields);
-      } else {
-        DeserializeRow(field_value, data);
-        assert(values.size() == static_cast<size_t>(fieldcount_));
+      codec_.Deserialize(field_value, data, fields);
+      assert(fields != nullptr || values.size() == static_cast<size_t>(fieldcount_));
+    }
+  }
+
+  return kOK;
+}
+
+DB::Status RocksdbDB::ScanVisitSingle(const std::string &table, const std::string &key, int len,
+                                      const std::vector<std::string> *fields,
+                                      const ScanVisitor &visitor) {
+  scan_keys_.clear();
+  scan_values_.clear();
+  rocksdb::Status s = db_->Scan(rocksdb::ReadOptions(), db_->DefaultColumnFamily(), rocksdb::Slice(key), len,
+                                &scan_keys_, &scan_values_);
+  if (!s.ok()) {
+    throw utils::Exception(std::string("RocksDB Scan: ") + s.ToString());
+  }
+
+  if (deserialize_on_read_) {
+    for (const std::string &data : scan_values_) {
+      scan_row_.clear();
+      codec_.DeserializeView(scan_row_, data.data(), data.size(), fields);
+      assert(fields != nullptr || scan_row_.size() == static_cast<size_t>(fieldcount_));
+      if (!visitor(scan_row_)) {
+        break;
       }
     }
   }
@@ -568,25 +552,11 @@ DB::Status RocksdbDB::UpdateSingle(const std::string &table, const std::string &
   } else if (!s.ok()) {
     throw utils::Exception(std::string("RocksDB Get: ") + s.ToString());
   }
-  std::vector<Field> current_values;
-  DeserializeRow(current_values, data);
-  assert(current_values.size() == static_cast<size_t>(fieldcount_));
-  for (Field &new_field : values) {
-    bool found MAYBE_UNUSED = false;
-    for (Field &cur_field : current_values) {
-      if (cur_field.name == new_field.name) {
-        found = true;
-        cur_field.value = new_field.value;
-        break;
-      }
-    }
-    assert(found);
-  }
+  // patches the changed fields into the fetched row
+  codec_.Update(data, values);
   rocksdb::WriteOptions wopt;
   wopt.disableWAL = disable_wal_;
 
-  data.clear();
-  SerializeRow(current_values, data);
   s = db_->Put(wopt, key, data);
   if (!s.ok()) {
     throw utils::Exception(std::string("RocksDB Put: ") + s.ToString());
@@ -606,7 +576,7 @@ DB::Status RocksdbDB::UpdateAllFieldsSingle(const std::string &table, const std:
   rocksdb::WriteOptions wopt;
   wopt.disableWAL = disable_wal_;
 
-  SerializeRow(values, data);
+  codec_.Serialize(values, data);
   rocksdb::Status s = db_->Put(wopt, key, data);
   if (!s.ok()) {
     throw utils::Exception(std::string("RocksDB Put: ") + s.ToString());
@@ -617,7 +587,7 @@ DB::Status RocksdbDB::UpdateAllFieldsSingle(const std::string &table, const std:
 DB::Status RocksdbDB::MergeSingle(const std::string &table, const std::string &key,
                                   std::vector<Field> &values) {
   std::string data;
-  SerializeRow(values, data);
+  codec_.Serialize(values, data);
   rocksdb::WriteOptions wopt;
   wopt.disableWAL = disable_wal_;
   rocksdb::Status s = db_->Merge(wopt, key, data);
@@ -630,7 +600,7 @@ DB::Status RocksdbDB::MergeSingle(const std::string &table, const std::string &k
 DB::Status RocksdbDB::InsertSingle(const std::string &table, const std::string &key,
                                    std::vector<Field> &values) {
   std::string data;
-  SerializeRow(values, data);
+  codec_.Serialize(values, data);
   rocksdb::WriteOptions wopt;
   wopt.disableWAL = disable_wal_;
   rocksdb::Status s = db_->Put(wopt, key, data);
@@ -650,6 +620,86 @@ DB::Status RocksdbDB::DeleteSingle(const std::string &table, const std::string &
   return kOK;
 }
 
+DB::Status RocksdbDB::BeginBulkLoad(const std::string &table) {
+  // the file is written inside the db directory and moved into the LSM on ingestion
+  const std::string &db_path = props_->GetProperty(PROP_NAME, PROP_NAME_DEFAULT);
+  sst_file_ = db_path + "/ycsb_bulkload_" + std::to_string(sst_file_id_.fetch_add(1)) + ".sst";
+  sst_entries_ = 0;
+  sst_writer_.reset(new rocksdb::SstFileWriter(rocksdb::EnvOptions(), db_->GetOptions()));
+  rocksdb::Status s = sst_writer_->Open(sst_file_);
+  if (!s.ok()) {
+    throw utils::Exception(std::string("RocksDB SstFileWriter Open: ") + s.ToString());
+  }
+  return kOK;
+}
+
+DB::Status RocksdbDB::BulkLoadPut(const std::string &table, const std::string &key,
+                                  std::vector<Field> &values) {
+  std::string data;
+  codec_.Serialize(values, data);
+  rocksdb::Status s = sst_writer_->Put(key, data);
+  if (!s.ok()) {
+    throw utils::Exception(std::string("RocksDB SstFileWriter Put: ") + s.ToString());
+  }
+  sst_entries_++;
+  return kOK;
+}
+
+DB::Status RocksdbDB::FinishBulkLoad(const std::string &table) {
+  if (sst_entries_ == 0) {
+    // an empty sst file cannot be finished, nothing to ingest
+    sst_writer_.reset();
+    std::remove(sst_file_.c_str());
+    return kOK;
+  }
+  rocksdb::Status s = sst_writer_->Finish();
+  sst_writer_.reset();
+  if (!s.ok()) {
+    throw utils::Exception(std::string("RocksDB SstFileWriter Finish: ") + s.ToString());
+  }
+  rocksdb::IngestExternalFileOptions ingest_opt;
+  ingest_opt.move_files = true;
+  s = db_->IngestExternalFile({sst_file_}, ingest_opt);
+  if (!s.ok()) {
+    throw utils::Exception(std::string("RocksDB IngestExternalFile: ") + s.ToString());
+  }
+  return kOK;
+}
+
+void RocksdbDB::StartCounters() {
+  // the perf level is per thread, and client threads may not have run Init
+  rocksdb::SetPerfLevel(rocksdb::PerfLevel::kEnableCount);
+  rocksdb::get_perf_context()->Reset();
+  rocksdb::get_iostats_context()->Reset();
+}
+
+void RocksdbDB::ReadCounters(EngineCounters &counters) {
+  const rocksdb::PerfContext &perf = *rocksdb::get_perf_context();
+  counters.value[BLOCK_CACHE_HIT] = perf.block_cache_hit_count;
+  counters.value[BLOCK_READ] = perf.block_read_count;
+  counters.value[BLOCK_READ_BYTES] = perf.block_read_byte;
+  counters.value[BYTES_READ] = rocksdb::get_iostats_context()->bytes_read;
+  counters.value[MEMTABLE_GET] = perf.get_from_memtable_count;
+  counters.value[SST_OP] = perf.block_cache_hit_count + perf.block_read_count > 0;
+  counters.value[SEEK] = perf.iter_seek_count;
+  counters.value[NEXT] = perf.iter_next_count;
+  counters.value[KEY_SKIPPED] = perf.internal_key_skipped_count;
+}
+
+void RocksdbDB::SampleEngineStats(EngineStats &stats) {
+  // the lock keeps the last client from closing the db underneath
+  const std::lock_guard<std::mutex> lock(mu_);
+  if (ref_cnt_ == 0) {
+    return;
+  }
+  for (const std::string &name : kEngineProperties) {
+    uint64_t value;
+    if (db_->GetIntProperty(name, &value)) {
+      stats.emplace_back(name, value);
+    }
+  }
+}
+
 DB *NewRocksdbDB() {
   return new RocksdbDB;
 }
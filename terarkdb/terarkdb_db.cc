@@ -8,6 +8,8 @@
 
 #include "terarkdb_db.h"
 
+#include <cstdio>
+
 #include "core/core_workload.h"
 #include "core/db_factory.h"
 #include "utils/utils.h"
@@ -139,48 +141,31 @@ std::vector<terarkdb::ColumnFamilyHandle *> RocksdbDB::cf_handles_;
 terarkdb::DB *RocksdbDB::db_ = nullptr;
 int RocksdbDB::ref_cnt_ = 0;
 std::mutex RocksdbDB::mu_;
+std::atomic<int> RocksdbDB::sst_file_id_(0);
 
 void RocksdbDB::Init() {
 // merge operator disabled by default due to link error
 #ifdef USE_MERGEUPDATE
   class YCSBUpdateMerge : public terarkdb::AssociativeMergeOperator {
    public:
+    explicit YCSBUpdateMerge(const RowCodec &codec) : codec_(codec) {}
+
     virtual bool Merge(const terarkdb::Slice &key, const terarkdb::Slice *existing_value,
                        const terarkdb::Slice &value, std::string *new_value,
                        terarkdb::Logger *logger) const override {
       assert(existing_value);
 
-      std::vector<Field> values;
-      const char *p = existing_value->data();
-      const char *lim = p + existing_value->size();
-      DeserializeRow(values, p, lim);
-
-      std::vector<Field> new_values;
-      p = value.data();
-      lim = p + value.size();
-      DeserializeRow(new_values, p, lim);
-
-      for (Field &new_field : new_values) {
-        bool found = false;
-        for (Field &field : values) {
-          if (field.name == new_field.name) {
-            found = true;
-            field.value = new_field.value;
-            break;
-          }
-        }
-        if (!found) {
-          values.push_back(new_field);
-        }
-      }
-
-      SerializeRow(values, *new_value);
+      new_value->assign(existing_value->data(), existing_value->size());
+      codec_.Merge(*new_value, value.data(), value.size());
       return true;
     }
 
     virtual const char *Name() const override {
       return "YCSBUpdateMerge";
     }
+
+   private:
+    RowCodec codec_;
   };
 #endif
   const std::lock_guard<std::mutex> lock(mu_);
@@ -190,7 +175,9 @@ void RocksdbDB::Init() {
   if (format == "single") {
     format_ = kSingleRow;
     method_read_ = &RocksdbDB::ReadSingle;
+    method_read_view_ = &RocksdbDB::ReadViewSingle;
     method_scan_ = &RocksdbDB::ScanSingle;
+    method_scan_visit_ = &RocksdbDB::ScanVisitSingle;
     method_update_ = &RocksdbDB::UpdateSingle;
     method_insert_ = &RocksdbDB::InsertSingle;
     method_delete_ = &RocksdbDB::DeleteSingle;
@@ -204,6 +191,7 @@ void RocksdbDB::Init() {
   }
   fieldcount_ = std::stoi(props.GetProperty(CoreWorkload::FIELD_COUNT_PROPERTY,
                                             CoreWorkload::FIELD_COUNT_DEFAULT));
+  codec_.Init(props);
   disable_wal_ = (props.GetProperty(PROP_DISABLE_WAL, PROP_DISABLE_WAL_DEFAULT) == "true");
   deserialize_on_read_ = (props.GetProperty(PROP_DESERIALIZE_ON_READ, PROP_DESERIALIZE_ON_READ_DEFAULT) == "true");
 
@@ -222,7 +210,7 @@ void RocksdbDB::Init() {
   std::vector<terarkdb::ColumnFamilyDescriptor> cf_descs;
   GetOptions(props, &opt, &cf_descs);
 #ifdef USE_MERGEUPDATE
-  opt.merge_operator.reset(new YCSBUpdateMerge);
+  opt.merge_operator.reset(new YCSBUpdateMerge(codec_));
 #endif
 
   terarkdb::Status s;
@@ -415,66 +403,6 @@ void RocksdbDB::GetOptions(const utils::Properties &props, terarkdb::Options *op
   }
 }
 
-void RocksdbDB::SerializeRow(const std::vector<Field> &values, std::string &data) {
-  for (const Field &field : values) {
-    uint32_t len = field.name.size();
-    data.append(reinterpret_cast<char *>(&len), sizeof(uint32_t));
-    data.append(field.name.data(), field.name.size());
-    len = field.value.size();
-    data.append(reinterpret_cast<char *>(&len), sizeof(uint32_t));
-    data.append(field.value.data(), field.value.size());
-  }
-}
-
-void RocksdbDB::DeserializeRowFilter(std::vector<Field> &values, const char *p, const char *lim,
-                                     const std::vector<std::string> &fields) {
-  std::vector<std::string>::const_iterator filter_iter = fields.begin();
-  while (p != lim && filter_iter != fields.end()) {
-    assert(p < lim);
-    uint32_t len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string field(p, static_cast<const size_t>(len));
-    p += len;
-    len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string value(p, static_cast<const size_t>(len));
-    p += len;
-    if (*filter_iter == field) {
-      values.push_back({field, value});
-      filter_iter++;
-    }
-  }
-  assert(values.size() == fields.size());
-}
-
-void RocksdbDB::DeserializeRowFilter(std::vector<Field> &values, const std::string &data,
-                                     const std::vector<std::string> &fields) {
-  const char *p = data.data();
-  const char *lim = p + data.size();
-  DeserializeRowFilter(values, p, lim, fields);
-}
-
-void RocksdbDB::DeserializeRow(std::vector<Field> &values, const char *p, const char *lim) {
-  while (p != lim) {
-    assert(p < lim);
-    uint32_t len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string field(p, static_cast<const size_t>(len));
-    p += len;
-    len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string value(p, static_cast<const size_t>(len));
-    p += len;
-    values.push_back({field, value});
-  }
-}
-
-void RocksdbDB::DeserializeRow(std::vector<Field> &values, const std::string &data) {
-  const char *p = data.data();
-  const char *lim = p + data.size();
-  DeserializeRow(values, p, lim);
-}
-
 DB::Status RocksdbDB::ReadSingle(const std::string &table, const std::string &key,
                                  const std::vector<std::string> *fields,
                                  std::vector<Field> &result) {
@@ -488,17 +416,30 @@ DB::Status RocksdbDB::ReadSingle(const std::string &table, const std::string &ke
 
   // Only deserialize if enabled
   if (deserialize_on_read_) {
-    if (fields != nullptr) {
-      DeserializeRowFilter(result, data, *fields);
-    } else {
-      DeserializeRow(result, data);
-      assert(result.size() == static_cast<size_t>(fieldcount_));
-    }
+    codec_.Deserialize(result, data, fields);
+    assert(fields != nullptr || result.size() == static_cast<size_t>(fieldcount_));
   }
 
   return kOK;
 }
 
+DB::Status RocksdbDB::ReadViewSingle(const std::string &table, const std::string &key,
+                                     const std::vector<std::string> *fields,
+                                     std::vector<FieldView> &result) {
+  result.clear();
+  // releases the block pinned by the previous read
+  pinned_value_.Reset();
+  terarkdb::Status s = db_->Get(terarkdb::ReadOptions(), db_->DefaultColumnFamily(), key, &pinned_value_);
+  if (s.IsNotFound()) {
+    return kNotFound;
+  } else if (!s.ok()) {
+    throw utils::Exception(std::string("RocksDB Get: ") + s.ToString());
+  }
+  codec_.DeserializeView(result, pinned_value_.data(), pinned_value_.size(), fields);
+  assert(fields != nullptr || result.size() == static_cast<size_t>(fieldcount_));
+  return kOK;
+}
+
 DB::Status RocksdbDB::ScanSingle(const std::string &table, const std::string &key, int len,
                                  const std::vector<std::string> *fields,
                                  std::vector<std::vector<Field>> &result) {
@@ -509,11 +450,29 @@ DB::Status RocksdbDB::ScanSingle(const std::string &table, const std::string &ke
     result.push_back(std::vector<Field>());
     std::vector<Field> &values = result.back();
     if (deserialize_on_read_) {
-      if (fields != nullptr) {
-        DeserializeRowFilter(values, data, *fields);
-      } else {
-        DeserializeRow(values, data);
-        assert(values.size() == static_cast<size_t>(fieldcount_));
+      codec_.Deserialize(values, data, fields);
+      assert(fields != nullptr || values.size() == static_cast<size_t>(fieldcount_));
+    }
+    db_iter->Next();
+  }
+  delete db_iter;
+  return kOK;
+}
+
+DB::Status RocksdbDB::ScanVisitSingle(const std::string &table, const std::string &key, int len,
+                                      const std::vector<std::string> *fields,
+                                      const ScanVisitor &visitor) {
+  terarkdb::Iterator *db_iter = db_->NewIterator(terarkdb::ReadOptions());
+  db_iter->Seek(key);
+  for (int i = 0; db_iter->Valid() && i < len; i++) {
+    // the value slice stays valid until the iterator moves
+    terarkdb::Slice data = db_iter->value();
+    if (deserialize_on_read_) {
+      scan_row_.clear();
+      codec_.DeserializeView(scan_row_, data.data(), data.size(), fields);
+      assert(fields != nullptr || scan_row_.size() == static_cast<size_t>(fieldcount_));
+      if (!visitor(scan_row_)) {
+        break;
       }
     }
     db_iter->Next();
@@ -536,25 +495,11 @@ DB::Status RocksdbDB::UpdateSingle(const std::string &table, const std::string &
   } else if (!s.ok()) {
     throw utils::Exception(std::string("RocksDB Get: ") + s.ToString());
   }
-  std::vector<Field> current_values;
-  DeserializeRow(current_values, data);
-  assert(current_values.size() == static_cast<size_t>(fieldcount_));
-  for (Field &new_field : values) {
-    bool found MAYBE_UNUSED = false;
-    for (Field &cur_field : current_values) {
-      if (cur_field.name == new_field.name) {
-        found = true;
-        cur_field.value = new_field.value;
-        break;
-      }
-    }
-    assert(found);
-  }
+  // patches the changed fields into the fetched row
+  codec_.Update(data, values);
   terarkdb::WriteOptions wopt;
   wopt.disableWAL = disable_wal_;
 
-  data.clear();
-  SerializeRow(current_values, data);
   s = db_->Put(wopt, key, data);
   if (!s.ok()) {
     throw utils::Exception(std::string("RocksDB Put: ") + s.ToString());
@@ -574,7 +519,7 @@ DB::Status RocksdbDB::UpdateAllFieldsSingle(const std::string &table, const std:
   terarkdb::WriteOptions wopt;
   wopt.disableWAL = disable_wal_;
 
-  SerializeRow(values, data);
+  codec_.Serialize(values, data);
   terarkdb::Status s = db_->Put(wopt, key, data);
   if (!s.ok()) {
     throw utils::Exception(std::string("RocksDB Put: ") + s.ToString());
@@ -585,7 +530,7 @@ DB::Status RocksdbDB::UpdateAllFieldsSingle(const std::string &table, const std:
 DB::Status RocksdbDB::MergeSingle(const std::string &table, const std::string &key,
                                   std::vector<Field> &values) {
   std::string data;
-  SerializeRow(values, data);
+  codec_.Serialize(values, data);
   terarkdb::WriteOptions wopt;
   wopt.disableWAL = disable_wal_;
   terarkdb::Status s = db_->Merge(wopt, key, data);
@@ -598,7 +543,7 @@ DB::Status RocksdbDB::MergeSingle(const std::string &table, const std::string &k
 DB::Status RocksdbDB::InsertSingle(const std::string &table, const std::string &key,
                                    std::vector<Field> &values) {
   std::string data;
-  SerializeRow(values, data);
+  codec_.Serialize(values, data);
   terarkdb::WriteOptions wopt;
   wopt.disableWAL = disable_wal_;
   terarkdb::Status s = db_->Put(wopt, key, data);
@@ -618,6 +563,52 @@ DB::Status RocksdbDB::DeleteSingle(const std::string &table, const std::string &
   return kOK;
 }
 
+DB::Status RocksdbDB::BeginBulkLoad(const std::string &table) {
+  // the file is written inside the db directory and moved into the LSM on ingestion
+  const std::string &db_path = props_->GetProperty(PROP_NAME, PROP_NAME_DEFAULT);
+  sst_file_ = db_path + "/ycsb_bulkload_" + std::to_string(sst_file_id_.fetch_add(1)) + ".sst";
+  sst_entries_ = 0;
+  sst_writer_.reset(new terarkdb::SstFileWriter(terarkdb::EnvOptions(), db_->GetOptions()));
+  terarkdb::Status s = sst_writer_->Open(sst_file_);
+  if (!s.ok()) {
+    throw utils::Exception(std::string("RocksDB SstFileWriter Open: ") + s.ToString());
+  }
+  return kOK;
+}
+
+DB::Status RocksdbDB::BulkLoadPut(const std::string &table, const std::string &key,
+                                  std::vector<Field> &values) {
+  std::string data;
+  codec_.Serialize(values, data);
+  terarkdb::Status s = sst_writer_->Put(key, data);
+  if (!s.ok()) {
+    throw utils::Exception(std::string("RocksDB SstFileWriter Put: ") + s.ToString());
+  }
+  sst_entries_++;
+  return kOK;
+}
+
+DB::Status RocksdbDB::FinishBulkLoad(const std::string &table) {
+  if (sst_entries_ == 0) {
+    // an empty sst file cannot be finished, nothing to ingest
+    sst_writer_.reset();
+    std::remove(sst_file_.c_str());
+    return kOK;
+  }
+  terarkdb::Status s = sst_writer_->Finish();
+  sst_writer_.reset();
+  if (!s.ok()) {
+    throw utils::Exception(std::string("RocksDB SstFileWriter Finish: ") + s.ToString());
+  }
+  terarkdb::IngestExternalFileOptions ingest_opt;
+  ingest_opt.move_files = true;
+  s = db_->IngestExternalFile({sst_file_}, ingest_opt);
+  if (!s.ok()) {
+    throw utils::Exception(std::string("RocksDB IngestExternalFile: ") + s.ToString());
+  }
+  return kOK;
+}
+
 DB *NewRocksdbDB() {
   return new RocksdbDB;
 }
@@ -0,0 +1,252 @@
+//
+//  affinity.h
+//  YCSB-cpp
+//
+
+#ifndef YCSB_C_AFFINITY_H_
+#define YCSB_C_AFFINITY_H_
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "utils.h"
+
+namespace ycsbc {
+
+namespace utils {
+
+///
+/// Parses a CPU list such as "0-3,8,10-11". An empty string gives an empty list.
+///
+inline std::vector<int> ParseCpuList(const std::string &list) {
+  std::vector<int> cpus;
+  size_t pos = 0;
+  while (pos < list.size()) {
+    size_t comma = list.find(',', pos);
+    if (comma == std::string::npos) {
+      comma = list.size();
+    }
+    const std::string range = Trim(list.substr(pos, comma - pos));
+    pos = comma + 1;
+    if (range.empty()) {
+      continue;
+    }
+    size_t dash = range.find('-');
+    try {
+      int first = std::stoi(range.substr(0, dash));
+      int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+      if (first < 0 || last < first) {
+        throw Exception("invalid cpu range: " + range);
+      }
+      for (int cpu = first; cpu <= last; cpu++) {
+        cpus.push_back(cpu);
+      }
+    } catch (const std::logic_error &) {
+      throw Exception("invalid cpu list: " + list);
+    }
+  }
+  return cpus;
+}
+
+#if defined(__linux__)
+
+namespace affinity_internal {
+  // mask the thread had before its first PinThread
+  struct Unpinned {
+    bool pinned = false;
+    cpu_set_t mask;
+  };
+
+  inline Unpinned &UnpinnedMask() {
+    static thread_local Unpinned unpinned;
+    return unpinned;
+  }
+
+  inline void SetMask(const cpu_set_t &mask) {
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &mask);
+    if (err != 0) {
+      throw Exception(std::string("pthread_setaffinity_np: ") + std::strerror(err));
+    }
+  }
+
+  inline cpu_set_t GetMask() {
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    int err = pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &mask);
+    if (err != 0) {
+      throw Exception(std::string("pthread_getaffinity_np: ") + std::strerror(err));
+    }
+    return mask;
+  }
+
+  inline cpu_set_t MakeMask(const std::vector<int> &cpus) {
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (int cpu : cpus) {
+      if (cpu >= CPU_SETSIZE) {
+        throw Exception("cpu out of range: " + std::to_string(cpu));
+      }
+      CPU_SET(cpu, &mask);
+    }
+    return mask;
+  }
+
+  // the NUMA nodes the kernel has online, node 0 alone without sysfs
+  inline std::vector<int> OnlineNodes() {
+    std::ifstream file("/sys/devices/system/node/online");
+    std::string list;
+    if (!std::getline(file, list)) {
+      return {0};
+    }
+    std::vector<int> nodes = ParseCpuList(list);
+    return nodes.empty() ? std::vector<int>{0} : nodes;
+  }
+} // affinity_internal
+
+///
+/// Pins the calling thread to the given CPUs. Threads started by it afterwards
+/// inherit the pinning; ScopedAffinity can lift it around such calls.
+///
+inline void PinThread(const std::vector<int> &cpus) {
+  affinity_internal::Unpinned &unpinned = affinity_internal::UnpinnedMask();
+  if (!unpinned.pinned) {
+    unpinned.mask = affinity_internal::GetMask();
+    unpinned.pinned = true;
+  }
+  affinity_internal::SetMask(affinity_internal::MakeMask(cpus));
+}
+
+///
+/// Sets the memory policy of the calling thread: "local" allocates on the node
+/// of the CPU the thread runs on, "interleave" spreads pages over all nodes,
+/// "none" keeps the default policy.
+///
+inline void SetMemoryPolicy(const std::string &policy) {
+  // numaif.h values, spelled out so libnuma is not needed
+  const int kMpolDefault = 0;
+  const int kMpolInterleave = 3;
+  const int kMpolLocal = 4;
+  long ret = 0;
+  if (policy == "none") {
+    ret = syscall(SYS_set_mempolicy, kMpolDefault, nullptr, 0);
+  } else if (policy == "local") {
+    ret = syscall(SYS_set_mempolicy, kMpolLocal, nullptr, 0);
+  } else if (policy == "interleave") {
+    // only online nodes: bits past the kernel's MAX_NUMNODES are rejected
+    const int kBits = sizeof(unsigned long) * 8;
+    const std::vector<int> online = affinity_internal::OnlineNodes();
+    const int max_node = *std::max_element(online.begin(), online.end());
+    std::vector<unsigned long> nodes(max_node / kBits + 1, 0);
+    for (int node : online) {
+      nodes[node / kBits] |= 1UL << (node % kBits);
+    }
+    // the kernel drops the last bit of maxnode, hence the + 2
+    ret = syscall(SYS_set_mempolicy, kMpolInterleave, nodes.data(), max_node + 2);
+  } else {
+    throw Exception("unknown numa policy: " + policy);
+  }
+  if (ret != 0) {
+    throw Exception(std::string("set_mempolicy: ") + std::strerror(errno));
+  }
+}
+
+///
+/// Moves the calling thread to the given CPUs until the end of the scope, so
+/// that threads it starts meanwhile land there. An empty list undoes the
+/// PinThread of the calling thread instead, if any.
+///
+class ScopedAffinity {
+ public:
+  explicit ScopedAffinity(const std::vector<int> &cpus) : active_(false) {
+    const affinity_internal::Unpinned &unpinned = affinity_internal::UnpinnedMask();
+    if (cpus.empty() && !unpinned.pinned) {
+      return;
+    }
+    saved_ = affinity_internal::GetMask();
+    affinity_internal::SetMask(cpus.empty() ? unpinned.mask
+                                            : affinity_internal::MakeMask(cpus));
+    active_ = true;
+  }
+  ~ScopedAffinity() {
+    if (active_) {
+      pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &saved_);
+    }
+  }
+  ScopedAffinity(const ScopedAffinity &) = delete;
+  ScopedAffinity &operator=(const ScopedAffinity &) = delete;
+
+ private:
+  bool active_;
+  cpu_set_t saved_;
+};
+
+#else
+
+inline void PinThread(const std::vector<int> &cpus) {
+  throw Exception("cpu affinity is only supported on Linux");
+}
+
+inline void SetMemoryPolicy(const std::string &policy) {
+  if (policy != "none") {
+    throw Exception("numa policy is only supported on Linux");
+  }
+}
+
+class ScopedAffinity {
+ public:
+  explicit ScopedAffinity(const std::vector<int> &cpus) {
+    if (!cpus.empty()) {
+      throw Exception("cpu affinity is only supported on Linux");
+    }
+  }
+};
+
+#endif
+
+///
+/// Placement of the client threads, from the cpu.affinity and numa.policy
+/// properties. Client thread i runs on the i-th CPU of the list, wrapping
+/// around. Apply is called first thing in the thread, so the buffers it
+/// allocates later (workload state, DB read and scan buffers) come from the
+/// memory of its node.
+///
+class ThreadPlacement {
+ public:
+  ThreadPlacement(const std::string &cpu_list, const std::string &numa_policy)
+      : cpus_(ParseCpuList(cpu_list)), numa_policy_(numa_policy) {
+    if (numa_policy_ != "none" && numa_policy_ != "local" && numa_policy_ != "interleave") {
+      throw Exception("unknown numa policy: " + numa_policy_);
+    }
+  }
+
+  void Apply(int index) const {
+    if (!cpus_.empty()) {
+      PinThread({cpus_[index % cpus_.size()]});
+    }
+    if (numa_policy_ != "none") {
+      SetMemoryPolicy(numa_policy_);
+    }
+  }
+
+ private:
+  std::vector<int> cpus_;
+  std::string numa_policy_;
+};
+
+} // utils
+
+} // ycsbc
+
+#endif // YCSB_C_AFFINITY_H_
@@ -8,6 +8,7 @@
 #ifndef YCSB_C_COUNTDOWN_LATCH_H_
 #define YCSB_C_COUNTDOWN_LATCH_H_
 
+#include <chrono>
 #include <mutex>
 #include <condition_variable>
 
@@ -22,9 +23,9 @@ class CountDownLatch {
     std::unique_lock<std::mutex> lock(mu_);
     cv_.wait(lock, [this]{return count_ <= 0;});
   }
-  bool AwaitFor(long timeout_sec) {
+  bool AwaitFor(double timeout_sec) {
     std::unique_lock<std::mutex> lock(mu_);
-    return cv_.wait_for(lock, std::chrono::seconds(timeout_sec), [this]{return count_ <= 0;});
+    return cv_.wait_for(lock, std::chrono::duration<double>(timeout_sec), [this]{return count_ <= 0;});
   }
   void CountDown() {
     std::unique_lock<std::mutex> lock(mu_);
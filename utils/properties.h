@@ -27,6 +27,7 @@ class Properties {
   const std::string &operator[](const std::string &key) const;
   void SetProperty(const std::string &key, const std::string &value);
   bool ContainsKey(const std::string &key) const;
+  const std::map<std::string, std::string> &properties() const { return properties_; }
   void Load(std::ifstream &input);
  private:
   std::map<std::string, std::string> properties_;
@@ -0,0 +1,142 @@
+//
+//  random.h
+//  YCSB-cpp
+//
+
+#ifndef YCSB_C_RANDOM_H_
+#define YCSB_C_RANDOM_H_
+
+#include <cassert>
+#include <cstdint>
+#include <random>
+
+namespace ycsbc {
+
+namespace utils {
+
+///
+/// Advances a splitmix64 state and returns the next output.
+/// Used to expand one seed into independent seeds for several generators.
+///
+inline uint64_t SplitMix64(uint64_t &state) {
+  uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+///
+/// Returns a non-deterministic seed.
+///
+inline uint64_t RandomSeed() {
+  std::random_device rd;
+  return (static_cast<uint64_t>(rd()) << 32) ^ rd();
+}
+
+///
+/// xoshiro256** pseudo random number generator. Not thread-safe, each
+/// thread is expected to own its instances.
+///
+class Xoshiro256 {
+ public:
+  explicit Xoshiro256(uint64_t seed = RandomSeed()) { Seed(seed); }
+
+  void Seed(uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+      s_[i] = SplitMix64(seed);
+    }
+  }
+
+  uint64_t Next() {
+    const uint64_t result = Rotl(s_[1] * 5, 7) * 9;
+    const uint64_t t = s_[1] << 17;
+    s_[2] ^= s_[0];
+    s_[3] ^= s_[1];
+    s_[1] ^= s_[2];
+    s_[0] ^= s_[3];
+    s_[2] ^= t;
+    s_[3] = Rotl(s_[3], 45);
+    return result;
+  }
+
+  // uniform in [0, 1)
+  double NextDouble() {
+    return (Next() >> 11) * 0x1.0p-53;
+  }
+
+  // uniform in [0, n), n > 0
+  uint64_t Uniform(uint64_t n) {
+#if defined(__SIZEOF_INT128__)
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(Next()) * n) >> 64);
+#else
+    return Next() % n;
+#endif
+  }
+
+ private:
+  static uint64_t Rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+  }
+
+  uint64_t s_[4];
+};
+
+///
+/// Pseudo random bijection on [0, n), evaluated on demand in O(1) memory.
+/// A balanced Feistel network permutes the smallest power of four covering n,
+/// and results outside [0, n) are fed through the network again until they
+/// land inside (cycle walking), which takes fewer than four rounds on average.
+///
+class RandomPermutation {
+ public:
+  RandomPermutation(uint64_t n, uint64_t seed) : n_(n), half_bits_(1) {
+    while (half_bits_ < 32 && (1ull << (2 * half_bits_)) < n) {
+      half_bits_++;
+    }
+    mask_ = (1ull << half_bits_) - 1;
+    for (int i = 0; i < kRounds; i++) {
+      keys_[i] = SplitMix64(seed);
+    }
+  }
+
+  uint64_t size() const { return n_; }
+
+  uint64_t operator()(uint64_t i) const {
+    assert(i < n_);
+    do {
+      i = Encrypt(i);
+    } while (i >= n_);
+    return i;
+  }
+
+ private:
+  static constexpr int kRounds = 4;
+
+  uint64_t Encrypt(uint64_t x) const {
+    uint64_t l = x >> half_bits_;
+    uint64_t r = x & mask_;
+    for (int i = 0; i < kRounds; i++) {
+      uint64_t t = l ^ (Round(r, keys_[i]) & mask_);
+      l = r;
+      r = t;
+    }
+    return (l << half_bits_) | r;
+  }
+
+  static uint64_t Round(uint64_t x, uint64_t key) {
+    uint64_t z = (x ^ key) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 31)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 29);
+  }
+
+  uint64_t n_;
+  int half_bits_;
+  uint64_t mask_;
+  uint64_t keys_[kRounds];
+};
+
+} // utils
+
+} // ycsbc
+
+#endif // YCSB_C_RANDOM_H_
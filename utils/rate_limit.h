@@ -9,68 +9,196 @@
 #define YCSB_C_RATE_LIMIT_H_
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <cstdio>
-#include <mutex>
-#include <ratio>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
 #include <thread>
+#include <vector>
+
+#include "utils.h"
 
 namespace ycsbc {
 
 namespace utils {
 
-// Token bucket rate limiter for single client
+// Pacing rate limiter for a single client thread.
+//
+// The limiter keeps the time the next operation is due instead of a token
+// count, so Consume and Schedule are a clock read and a few arithmetic
+// operations with no lock. Only SetRate may be called from another thread.
+// Waits sleep until shortly before the deadline and spin for the rest, since
+// sleep_for alone overshoots by tens of microseconds and would undershoot
+// the target at rates of millions of operations per second.
 class RateLimiter {
  public:
-  RateLimiter(int64_t r, int64_t b) : r_(r * TOKEN_PRECISION), b_(b * TOKEN_PRECISION), tokens_(0), last_(Clock::now()) {}
+  using Clock = std::chrono::steady_clock;
 
-  inline void Consume(int64_t n) {
-    std::unique_lock<std::mutex> lock(mutex_);
+  RateLimiter(int64_t r, int64_t b, bool open_loop = false)
+      : r_(r), b_(b), origin_(Clock::now()), next_(0), open_loop_(open_loop), scheduled_(false) {}
 
-    if (r_ <= 0) {
-      return;
+  bool open_loop() const { return open_loop_; }
+
+  // Closed-loop pacing: waits until n more operations fit the rate and
+  // returns the time they were allowed to start, which is in the past when
+  // they fit the unused budget. Up to b operations of unused budget are kept,
+  // which allows short bursts.
+  inline Clock::time_point Consume(int64_t n) {
+    int64_t r = r_.load(std::memory_order_relaxed);
+    if (r <= 0) {
+      return Clock::time_point();
     }
+    double interval = 1e9 / r;
+    double now = Now();
+    next_ = std::max(next_, now - b_ * interval) + n * interval;
+    WaitUntil(next_, now);
+    return ToTimePoint(next_);
+  }
+
+  // Open-loop pacing: returns the intended start time of the next operation
+  // and sleeps until then. The schedule advances by 1/r per operation no matter
+  // how long the previous one took, so a stalled request delays the intended
+  // start of every request queued behind it instead of silently thinning them.
+  // A batch of n operations is issued once its last member is due, and its
+  // latency is charged from the arrival of the first.
+  inline Clock::time_point Schedule(int64_t n = 1) {
+    int64_t r = r_.load(std::memory_order_relaxed);
+    double now = Now();
+    if (r <= 0) {
+      scheduled_ = false;
+      return ToTimePoint(now);
+    }
+    if (!scheduled_) {
+      next_ = now;
+      scheduled_ = true;
+    }
+    double interval = 1e9 / r;
+    double intended = next_;
+    double due = next_ + interval * (n - 1);
+    next_ += interval * n;
+    WaitUntil(due, now);
+    return ToTimePoint(intended);
+  }
+
+  // Restarts the open-loop schedule from the next call to Schedule()
+  inline void ResetSchedule() {
+    scheduled_ = false;
+  }
+
+  // Changes the rate; safe to call from any thread
+  inline void SetRate(int64_t r) {
+    r_.store(r, std::memory_order_relaxed);
+  }
+
+ private:
+  // deadlines closer than this are waited for by spinning
+  static constexpr double kSpinNanos = 50000;
+
+  // nanoseconds since origin_; a double keeps the fraction of an interval
+  // that integer nanoseconds would drop at high rates
+  double Now() const {
+    return std::chrono::duration<double, std::nano>(Clock::now() - origin_).count();
+  }
 
-    // refill tokens
-    auto now = Clock::now();
-    auto diff = std::chrono::duration_cast<Duration>(now - last_);
-    tokens_ = std::min(b_, tokens_ + diff.count() * r_ / 1000000000);
-    last_ = now;
+  Clock::time_point ToTimePoint(double t) const {
+    return origin_ + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::nano>(t));
+  }
 
-    // check tokens
-    tokens_ -= n * TOKEN_PRECISION;
+  static void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+  }
 
-    // sleep
-    if (tokens_ < 0) {
-      lock.unlock();
-      int64_t wait_time = -tokens_ * 1000000000 / r_;
-      std::this_thread::sleep_for(std::chrono::nanoseconds(wait_time));
+  void WaitUntil(double deadline, double now) const {
+    if (deadline - now > kSpinNanos) {
+      std::this_thread::sleep_until(ToTimePoint(deadline - kSpinNanos));
+    }
+    while (Now() < deadline) {
+      CpuRelax();
     }
   }
 
-  inline void SetRate(int64_t r) {
-    std::lock_guard<std::mutex> lock(mutex_);
+  std::atomic<int64_t> r_;
+  const int64_t b_;
+  const Clock::time_point origin_;
+  double next_;
+  const bool open_loop_;
+  bool scheduled_;
+};
 
-    // refill tokens
-    auto now = Clock::now();
-    auto diff = std::chrono::duration_cast<Duration>(now - last_);
-    tokens_ = std::min(b_, tokens_ + diff.count() * r_ * TOKEN_PRECISION / 1000000000);
-    last_ = now;
+// Aggregate target rate as a function of the seconds since the phase started,
+// given by the limit.curve property:
+//
+//   ramp:<from>:<to>:<seconds>          linear from -> to, then holds at to
+//   step:<from>:<increment>:<seconds>   adds increment every seconds
+//   sine:<mean>:<amplitude>:<seconds>   sine wave with the given period
+class RateCurve {
+ public:
+  explicit RateCurve(const std::string &spec) {
+    std::vector<std::string> parts;
+    size_t pos = 0;
+    while (true) {
+      size_t colon = spec.find(':', pos);
+      parts.push_back(Trim(spec.substr(pos, colon - pos)));
+      if (colon == std::string::npos) {
+        break;
+      }
+      pos = colon + 1;
+    }
+    if (parts.size() != 4) {
+      throw Exception("invalid rate curve: " + spec);
+    }
+    if (parts[0] == "ramp") {
+      shape_ = kRamp;
+    } else if (parts[0] == "step") {
+      shape_ = kStep;
+    } else if (parts[0] == "sine") {
+      shape_ = kSine;
+    } else {
+      throw Exception("unknown rate curve: " + parts[0]);
+    }
+    try {
+      a_ = std::stod(parts[1]);
+      b_ = std::stod(parts[2]);
+      seconds_ = std::stod(parts[3]);
+    } catch (const std::logic_error &) {
+      throw Exception("invalid rate curve: " + spec);
+    }
+    if (seconds_ <= 0) {
+      throw Exception("rate curve duration must be positive: " + spec);
+    }
+  }
 
-    // set rate
-    r_ = r * TOKEN_PRECISION;
+  int64_t RateAt(double t) const {
+    double rate = 0;
+    switch (shape_) {
+      case kRamp:
+        rate = a_ + (b_ - a_) * std::min(t / seconds_, 1.0);
+        break;
+      case kStep:
+        rate = a_ + b_ * std::floor(t / seconds_);
+        break;
+      case kSine:
+        rate = a_ + b_ * std::sin(2 * kPi * t / seconds_);
+        break;
+    }
+    // a rate of 0 would lift the limit altogether
+    return std::max<int64_t>(1, std::llround(rate));
   }
 
  private:
-  using Clock = std::chrono::steady_clock;
-  using Duration = std::chrono::nanoseconds;
-  static constexpr int64_t TOKEN_PRECISION = 10000;
-
-  std::mutex mutex_;
-  int64_t r_;
-  int64_t b_;
-  int64_t tokens_;
-  Clock::time_point last_;
+  enum Shape { kRamp, kStep, kSine };
+  static constexpr double kPi = 3.14159265358979323846;
+
+  Shape shape_;
+  double a_;
+  double b_;
+  double seconds_;
 };
 
 } // utils
@@ -10,6 +10,13 @@
 #define YCSB_C_TIMER_H_
 
 #include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
 
 namespace ycsbc {
 
@@ -18,10 +25,16 @@ namespace utils {
 template <typename R, typename P = std::ratio<1>>
 class Timer {
  public:
+  using Clock = std::chrono::steady_clock;
+
   void Start() {
     time_ = Clock::now();
   }
 
+  void Start(Clock::time_point t) {
+    time_ = t;
+  }
+
   R End() {
     Duration span;
     Clock::time_point t = Clock::now();
@@ -31,11 +44,65 @@ class Timer {
 
  private:
   using Duration = std::chrono::duration<R, P>;
-  using Clock = std::chrono::high_resolution_clock;
 
   Clock::time_point time_;
 };
 
+///
+/// Cheap monotonic tick counter for timing single operations: the time stamp
+/// counter on x86-64 if it runs at a constant rate, the virtual counter on
+/// aarch64, steady_clock nanoseconds otherwise. Ticks are converted with a
+/// rate calibrated against steady_clock once, on first use of NanosPerTick.
+///
+class TscClock {
+ public:
+  static uint64_t Ticks() {
+#if defined(__x86_64__)
+    if (kInvariantTsc) {
+      return __rdtsc();
+    }
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#endif
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  static double NanosPerTick() {
+    static const double nanos_per_tick = Calibrate();
+    return nanos_per_tick;
+  }
+
+  static uint64_t ToNanos(uint64_t ticks) {
+    return static_cast<uint64_t>(ticks * NanosPerTick());
+  }
+
+ private:
+  static bool InvariantTsc() {
+#if defined(__x86_64__)
+    // CPUID.80000007H:EDX[8], the counter rate does not change with P-states
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1u << 8)) != 0;
+#else
+    return false;
+#endif
+  }
+
+  static double Calibrate() {
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    uint64_t start_ticks = Ticks();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    uint64_t end_ticks = Ticks();
+    std::chrono::duration<double, std::nano> span = Clock::now() - start;
+    return span.count() / (end_ticks - start_ticks);
+  }
+
+  static inline const bool kInvariantTsc = InvariantTsc();
+};
+
 } // utils
 
 } // ycsbc
@@ -45,6 +45,9 @@ namespace {
   const std::string PROP_IN_MEMORY = WT_PREFIX ".in_memory";
   const std::string PROP_IN_MEMORY_DEFAULT = "false";
 
+  const std::string PROP_STATISTICS = WT_PREFIX ".statistics";
+  const std::string PROP_STATISTICS_DEFAULT = "none";
+
   const std::string PROP_LSM_MGR_MERGE = WT_PREFIX ".lsm_mgr.merge";
   const std::string PROP_LSM_MGR_MERGE_DEFAULT = "true";
 
@@ -80,6 +83,14 @@ namespace {
 
   const std::string PROP_BLK_MGR_BTREE_LEAF_PAGE_MAX = WT_PREFIX ".blk_mgr.btree.leaf_page_max";
   const std::string PROP_BLK_MGR_BTREE_LEAF_PAGE_MAX_DEFAULT = "32KB";
+
+  // connection statistics sampled by the status thread, see WTDB::SampleEngineStats
+  const std::pair<int, const char *> kEngineStatistics[] = {
+    {WT_STAT_CONN_CACHE_BYTES_INUSE, WT_PREFIX ".cache_bytes_inuse"},
+    {WT_STAT_CONN_CACHE_BYTES_DIRTY, WT_PREFIX ".cache_bytes_dirty"},
+    {WT_STAT_CONN_CACHE_BYTES_MAX, WT_PREFIX ".cache_bytes_max"},
+    {WT_STAT_CONN_TXN_CHECKPOINT_RUNNING, WT_PREFIX ".checkpoint_running"},
+  };
 }
 
 namespace ycsbc {
@@ -93,12 +104,13 @@ void WTDB::Init(){
 
   const utils::Properties &props = *props_;
   const std::string &format = props.GetProperty(PROP_FORMAT, PROP_FORMAT_DEFAULT);
-  fieldcount_ = std::stoi(props.GetProperty(CoreWorkload::FIELD_COUNT_PROPERTY,
-                                            CoreWorkload::FIELD_COUNT_DEFAULT));
+  codec_.Init(props);
 
   if(format=="single"){
     method_read_ = &WTDB::ReadSingleEntry;
+    method_read_view_ = &WTDB::ReadViewSingleEntry;
     method_scan_ = &WTDB::ScanSingleEntry;
+    method_scan_visit_ = &WTDB::ScanVisitSingleEntry;
     method_update_ = &WTDB::UpdateSingleEntry;
     method_insert_ = &WTDB::InsertSingleEntry;
     method_delete_ = &WTDB::DeleteSingleEntry;
@@ -131,9 +143,11 @@ void WTDB::Init(){
       const std::string &cache_size = props.GetProperty(PROP_CACHE_SIZE, PROP_CACHE_SIZE_DEFAULT);
       const std::string &direct_io = props.GetProperty(PROP_DIRECT_IO, PROP_DIRECT_IO_DEFAULT);
       const std::string &in_memory = props.GetProperty(PROP_IN_MEMORY, PROP_IN_MEMORY_DEFAULT);
+      const std::string &statistics = props.GetProperty(PROP_STATISTICS, PROP_STATISTICS_DEFAULT);
       if(!cache_size.empty()) db_config += "cache_size="+ cache_size+ ",";
       if(!direct_io.empty())  db_config += "direct_io=" + direct_io + ",";
       if(!in_memory.empty())  db_config += "in_memory=" + in_memory + ",";
+      if(!statistics.empty()) db_config += "statistics=(" + statistics + "),";
     }
     { // 2.2 LSM Manager
       std::string lsm_config;
@@ -204,6 +218,32 @@ void WTDB::Cleanup(){
   error_check(conn_->close(conn_, NULL));
 }
 
+void WTDB::SampleEngineStats(EngineStats &stats){
+  // the lock keeps the last client from closing the connection underneath
+  const std::lock_guard<std::mutex> lock(mu_);
+  if (ref_cnt_ == 0) {
+    return;
+  }
+  // sessions are single threaded, so the status thread opens its own
+  WT_SESSION *session;
+  if (conn_->open_session(conn_, NULL, NULL, &session) != 0) {
+    return;
+  }
+  WT_CURSOR *cursor;
+  // fails unless the connection was opened with statistics enabled
+  if (session->open_cursor(session, "statistics:", NULL, NULL, &cursor) == 0) {
+    for (const auto &stat : kEngineStatistics) {
+      const char *desc, *pvalue;
+      int64_t value;
+      cursor->set_key(cursor, stat.first);
+      if (cursor->search(cursor) == 0 && cursor->get_value(cursor, &desc, &pvalue, &value) == 0) {
+        stats.emplace_back(stat.second, value);
+      }
+    }
+  }
+  session->close(session, NULL);
+}
+
 DB::Status WTDB::ReadSingleEntry(const std::string &table, const std::string &key,
                                       const std::vector<std::string> *fields,
                                       std::vector<Field> &result) {
@@ -218,11 +258,28 @@ DB::Status WTDB::ReadSingleEntry(const std::string &table, const std::string &ke
     throw utils::Exception(WT_PREFIX " search error");
   }
   error_check(cursor_->get_value(cursor_, &v));
-  if (fields != nullptr) {
-    DeserializeRowFilter(&result, (const char*)v.data, v.size, *fields);
-  } else {
-    DeserializeRow(&result, (const char*)v.data, v.size);
+  codec_.Deserialize(result, (const char*)v.data, v.size, fields);
+  return kOK;
+}
+
+DB::Status WTDB::ReadViewSingleEntry(const std::string &table, const std::string &key,
+                                     const std::vector<std::string> *fields,
+                                     std::vector<FieldView> &result) {
+  WT_ITEM k = {key.data(), key.size()};
+  WT_ITEM v;
+  int ret;
+  result.clear();
+  cursor_->set_key(cursor_, &k);
+  ret = cursor_->search(cursor_);
+  if(ret==WT_NOTFOUND){
+    return kNotFound;
+  } else if(ret != 0) {
+    throw utils::Exception(WT_PREFIX " search error");
   }
+  // v points into the page pinned by the positioned cursor, which stays
+  // valid until the cursor is next used or reset
+  error_check(cursor_->get_value(cursor_, &v));
+  codec_.DeserializeView(result, (const char*)v.data, v.size, fields);
   return kOK;
 }
 
@@ -241,18 +298,41 @@ DB::Status WTDB::ScanSingleEntry(const std::string &table, const std::string &ke
   for(int i=0; !ret && i<len; ++i){
     error_check(cursor_->get_value(cursor_, &v));
     result.emplace_back(std::vector<Field>());
-    if (fields != nullptr) {
-      DeserializeRowFilter(&result.back(), (const char*)v.data, v.size, *fields);
-    } else {
-      DeserializeRow(&result.back(), (const char*)v.data, v.size);
+    codec_.Deserialize(result.back(), (const char*)v.data, v.size, fields);
+  }
+  return kOK;
+}
+
+DB::Status WTDB::ScanVisitSingleEntry(const std::string &table, const std::string &key, int len,
+                                      const std::vector<std::string> *fields,
+                                      const ScanVisitor &visitor) {
+  WT_ITEM k = {key.data(), key.size()};
+  WT_ITEM v;
+  int ret = 0, exact;
+
+  cursor_->set_key(cursor_, &k);
+  error_check(cursor_->search_near(cursor_, &exact));
+  if (exact < 0) {
+    ret = cursor_->next(cursor_);
+  }
+  for(int i=0; !ret && i<len; ++i){
+    // v stays valid until the cursor moves
+    error_check(cursor_->get_value(cursor_, &v));
+    scan_row_.clear();
+    codec_.DeserializeView(scan_row_, (const char*)v.data, v.size, fields);
+    if (!visitor(scan_row_)) {
+      break;
     }
+    ret = cursor_->next(cursor_);
+  }
+  if (ret != 0 && ret != WT_NOTFOUND) {
+    throw utils::Exception(WT_PREFIX " next error");
   }
   return kOK;
 }
 
 DB::Status WTDB::UpdateSingleEntry(const std::string &table, const std::string &key,
                            std::vector<Field> &values){
-  std::vector<Field> current_values;
   WT_ITEM k = {key.data(), key.size()};
   WT_ITEM v;
   int ret;
@@ -265,21 +345,10 @@ DB::Status WTDB::UpdateSingleEntry(const std::string &table, const std::string &
     throw utils::Exception(WT_PREFIX " search error");
   }
   error_check(cursor_->get_value(cursor_, &v));
-  DeserializeRow(&current_values, (const char*)v.data, v.size);
-  for (Field &new_field : values) {
-    bool found MAYBE_UNUSED = false;
-    for (Field &cur_field : current_values) {
-      if (cur_field.name == new_field.name) {
-        found = true;
-        cur_field.value = new_field.value;
-        break;
-      }
-    }
-    assert(found);
-  }
+  // patches the changed fields into a copy of the fetched row
+  std::string data((const char*)v.data, v.size);
+  codec_.Update(data, values);
 
-  std::string data;
-  SerializeRow(current_values, &data);
   v.data = data.data();
   v.size = data.size();
   cursor_->set_value(cursor_, &v);
@@ -298,7 +367,7 @@ DB::Status WTDB::InsertSingleEntry(const std::string &table, const std::string &
   WT_ITEM k = {key.data(), key.size()}, v;
   
   cursor_->set_key(cursor_, &k);
-  SerializeRow(values, &data);
+  codec_.Serialize(values, data);
   v.data = data.data();
   v.size = data.size();
   cursor_->set_value(cursor_, &v);
@@ -313,56 +382,55 @@ DB::Status WTDB::DeleteSingleEntry(const std::string &table, const std::string &
   return kOK;
 }
 
-void WTDB::SerializeRow(const std::vector<Field> &values, std::string *data) {
-  for (const Field &field : values) {
-    uint32_t len = field.name.size();
-    data->append(reinterpret_cast<char *>(&len), sizeof(uint32_t)); // 4B
-    data->append(field.name.data(), field.name.size());             // len(name)
-    len = field.value.size();
-    data->append(reinterpret_cast<char *>(&len), sizeof(uint32_t)); // 4B
-    data->append(field.value.data(), field.value.size());           // len(value)
-  }
-}
-
-void WTDB::DeserializeRow(std::vector<Field> *values, const char *data_ptr, size_t data_len) {
-  const char *p = data_ptr;
-  const char *lim = p + data_len;
-  while (p != lim) {
-    assert(p < lim);
-    uint32_t len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string field(p, static_cast<const size_t>(len));
-    p += len;
-    len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string value(p, static_cast<const size_t>(len));
-    p += len;
-    values->push_back({field, value});
+DB::Status WTDB::BatchRead(const std::string &table, const std::vector<std::string> &keys,
+                           const std::vector<std::string> *fields,
+                           std::vector<std::vector<Field>> &results, std::vector<Status> &statuses) {
+  // one snapshot transaction for the whole batch
+  Status s = kOK;
+  int ret;
+  error_check(session_->begin_transaction(session_, NULL));
+  results.clear();
+  results.resize(keys.size());
+  statuses.assign(keys.size(), kOK);
+  for (size_t i = 0; i < keys.size(); i++) {
+    WT_ITEM k = {keys[i].data(), keys[i].size()};
+    WT_ITEM v;
+    cursor_->set_key(cursor_, &k);
+    ret = cursor_->search(cursor_);
+    if(ret==WT_NOTFOUND){
+      s = statuses[i] = kNotFound;
+      continue;
+    } else if(ret != 0) {
+      session_->rollback_transaction(session_, NULL);
+      throw utils::Exception(WT_PREFIX " search error");
+    }
+    error_check(cursor_->get_value(cursor_, &v));
+    codec_.Deserialize(results[i], (const char*)v.data, v.size, fields);
   }
-  assert(values->size() == fieldcount_);
+  error_check(session_->rollback_transaction(session_, NULL));
+  return s;
 }
 
-void WTDB::DeserializeRowFilter(std::vector<Field> *values, const char *data_ptr, size_t data_len,
-                                  const std::vector<std::string> &fields) {
-  const char *p = data_ptr;
-  const char *lim = p + data_len;
-  std::vector<std::string>::const_iterator filter_iter = fields.begin();
-  while (p != lim && filter_iter != fields.end()) {
-    assert(p < lim);
-    uint32_t len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string field(p, static_cast<const size_t>(len));
-    p += len;
-    len = *reinterpret_cast<const uint32_t *>(p);
-    p += sizeof(uint32_t);
-    std::string value(p, static_cast<const size_t>(len));
-    p += len;
-    if (*filter_iter == field) {
-      values->push_back({field, value});
-      filter_iter++;
+DB::Status WTDB::BatchWrite(const std::string &table, const std::vector<std::string> &keys,
+                            std::vector<std::vector<Field>> &values) {
+  // commit the whole batch as one transaction
+  std::string data;
+  error_check(session_->begin_transaction(session_, NULL));
+  for (size_t i = 0; i < keys.size(); i++) {
+    WT_ITEM k = {keys[i].data(), keys[i].size()}, v;
+    cursor_->set_key(cursor_, &k);
+    data.clear();
+    codec_.Serialize(values[i], data);
+    v.data = data.data();
+    v.size = data.size();
+    cursor_->set_value(cursor_, &v);
+    if (cursor_->insert(cursor_) != 0) {
+      session_->rollback_transaction(session_, NULL);
+      throw utils::Exception(WT_PREFIX " insert error");
     }
   }
-  assert(values->size() == fields.size());
+  error_check(session_->commit_transaction(session_, NULL));
+  return kOK;
 }
 
 DB *NewWTDB() {
@@ -8,6 +8,7 @@
 #include <mutex>
 
 #include "core/db.h"
+#include "core/row_codec.h"
 #include "utils/properties.h"
 
 #include "wiredtiger.h"
@@ -29,11 +30,21 @@ class WTDB : public DB {
     return (this->*(method_read_))(table, key, fields, result);
   }
 
+  Status ReadView(const std::string &table, const std::string &key,
+                  const std::vector<std::string> *fields, std::vector<FieldView> &result) {
+    return (this->*(method_read_view_))(table, key, fields, result);
+  }
+
   Status Scan(const std::string &table, const std::string &key, int len,
               const std::vector<std::string> *fields, std::vector<std::vector<Field>> &result) {
     return (this->*(method_scan_))(table, key, len, fields, result);
   }
 
+  Status ScanVisit(const std::string &table, const std::string &key, int len,
+                   const std::vector<std::string> *fields, const ScanVisitor &visitor) {
+    return (this->*(method_scan_visit_))(table, key, len, fields, visitor);
+  }
+
   Status Update(const std::string &table, const std::string &key, std::vector<Field> &values) {
     return (this->*(method_update_))(table, key, values);
   }
@@ -46,35 +57,49 @@ class WTDB : public DB {
     return (this->*(method_delete_))(table, key);
   }
 
+  Status BatchRead(const std::string &table, const std::vector<std::string> &keys,
+                   const std::vector<std::string> *fields,
+                   std::vector<std::vector<Field>> &results, std::vector<Status> &statuses);
+
+  Status BatchWrite(const std::string &table, const std::vector<std::string> &keys,
+                    std::vector<std::vector<Field>> &values);
+
+  void SampleEngineStats(EngineStats &stats);
+
  private:
 
   Status ReadSingleEntry(const std::string &table, const std::string &key,
                          const std::vector<std::string> *fields, std::vector<Field> &result);
+  Status ReadViewSingleEntry(const std::string &table, const std::string &key,
+                             const std::vector<std::string> *fields, std::vector<FieldView> &result);
   Status ScanSingleEntry(const std::string &table, const std::string &key, int len,
                          const std::vector<std::string> *fields,
                          std::vector<std::vector<Field>> &result);
+  Status ScanVisitSingleEntry(const std::string &table, const std::string &key, int len,
+                              const std::vector<std::string> *fields, const ScanVisitor &visitor);
   Status UpdateSingleEntry(const std::string &table, const std::string &key,
                            std::vector<Field> &values);
   Status InsertSingleEntry(const std::string &table, const std::string &key,
                            std::vector<Field> &values);
   Status DeleteSingleEntry(const std::string &table, const std::string &key);
 
-  void SerializeRow(const std::vector<Field> &values, std::string *data);
-  void DeserializeRow(std::vector<Field> *values, const char *data_ptr, size_t data_len);
-  void DeserializeRowFilter(std::vector<Field> *values, const char *data_ptr, size_t data_len, const std::vector<std::string> &fields);
-
   Status (WTDB::*method_read_)(const std::string &, const std:: string &,
                                     const std::vector<std::string> *, std::vector<Field> &);
+  Status (WTDB::*method_read_view_)(const std::string &, const std::string &,
+                                    const std::vector<std::string> *, std::vector<FieldView> &);
   Status (WTDB::*method_scan_)(const std::string &, const std::string &, int,
                                     const std::vector<std::string> *,
                                     std::vector<std::vector<Field>> &);
+  Status (WTDB::*method_scan_visit_)(const std::string &, const std::string &, int,
+                                     const std::vector<std::string> *,
+                                     const ScanVisitor &);
   Status (WTDB::*method_update_)(const std::string &, const std::string &,
                                       std::vector<Field> &);
   Status (WTDB::*method_insert_)(const std::string &, const std::string &,
                                       std::vector<Field> &);
   Status (WTDB::*method_delete_)(const std::string &, const std::string &);
   
-  unsigned fieldcount_;
+  RowCodec codec_;
 
   static WT_CONNECTION *conn_;
   WT_SESSION *session_{nullptr};